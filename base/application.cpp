@@ -1,6 +1,6 @@
 #include "application.h"
 
-Application::Application()
+Application::Application(bool visible)
 {
 	if (glfwInit() != GLFW_TRUE)
 	{
@@ -11,6 +11,8 @@ Application::Application()
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+	// an invisible window still provides a context for offline work
+	glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 
 #ifdef __APPLE__
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
@@ -13,7 +13,9 @@
 class Model : public Object3D
 {
 public:
-	Model(const std::string &filepath, const std::string name);
+	// geometry loaded by the caller (e.g. a mapped mesh cache), the obj at filepath is only parsed again by export_model
+	Model(const std::string &filepath, const std::string name, const Vertex *vertices, size_t vertexCount,
+		  const uint32_t *indices, size_t indexCount, glm::vec3 minBounds, glm::vec3 maxBounds);
 
 	Model(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices);
 
@@ -36,9 +38,10 @@ public:
 
 private:
 	std::string _name;
-	// vertices of the table represented in model's own coordinate
-	std::vector<Vertex> _vertices;
-	std::vector<uint32_t> _indices;
+	std::string _path;
+	// counts of the vertices (model's own coordinate) and indices on the gpu
+	size_t _vertexCount = 0;
+	size_t _indexCount = 0;
 
 	// opengl objects
 	GLuint _vao = 0;
@@ -55,5 +58,5 @@ private:
 	a_attrib _attrib;
 	a_shape _shapes;
 
-	void initGLResources();
+	void initGLResources(const Vertex *vertices, size_t vertexCount, const uint32_t *indices, size_t indexCount);
 };
\ No newline at end of file
@@ -19,6 +19,16 @@ Shader::Shader(const std::string &vsFilepath, const std::string &fsFilepath)
     createShaderProgram(vsCode, fsCode);
 }
 
+/*
+ * @brief constructor, read compute shader code from file to create opengl compute program
+ */
+Shader::Shader(const std::string &csFilepath)
+{
+    std::string csCode = readFile(csFilepath);
+
+    createComputeProgram(csCode);
+}
+
 Shader::Shader(Shader &&shader) noexcept
 {
     _id = shader._id;
@@ -64,6 +74,11 @@ void Shader::setInt(const std::string &name, int value) const
     glUniform1i(glGetUniformLocation(_id, name.c_str()), value);
 }
 
+void Shader::setUint(const std::string &name, unsigned int value) const
+{
+    glUniform1ui(glGetUniformLocation(_id, name.c_str()), value);
+}
+
 /*
  * @brief set float uniform variable to shader
  * @param name name of the variable
@@ -132,25 +147,47 @@ void Shader::setMat4(const std::string &name, const glm::mat4 &mat4) const
 /*
  * @brief read shader code from file
  * @param filepath path to the file
- * @return shader code in string
+ * @return shader code in string, with #include "file" lines replaced by the
+ *         content of file (resolved relative to the including file)
  */
 std::string Shader::readFile(const std::string &filePath)
 {
     std::ifstream is;
     is.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 
+    std::string code;
     try
     {
         is.open(filePath);
         std::stringstream ss;
         ss << is.rdbuf();
 
-        return ss.str();
+        code = ss.str();
     }
     catch (std::ifstream::failure &e)
     {
         throw std::runtime_error(std::string("read ") + filePath + "error: " + e.what());
     }
+
+    const std::string directory = filePath.substr(0, filePath.find_last_of('/') + 1);
+    std::stringstream in(code), out;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        size_t pos = line.find("#include");
+        size_t begin = line.find('"');
+        size_t end = line.find_last_of('"');
+        if (pos != std::string::npos && begin != std::string::npos && end > begin)
+        {
+            out << readFile(directory + line.substr(begin + 1, end - begin - 1)) << "\n";
+        }
+        else
+        {
+            out << line << "\n";
+        }
+    }
+
+    return out.str();
 }
 
 /*
@@ -239,3 +276,50 @@ void Shader::createShaderProgram(const std::string &vsCode, const std::string &f
         throw e;
     }
 }
+
+
+/*
+ * @brief create a compute shader program
+ * @param csCode compute shader code
+ */
+void Shader::createComputeProgram(const std::string &csCode)
+{
+    GLuint cs = 0;
+    try
+    {
+        cs = createShader(csCode, GL_COMPUTE_SHADER);
+        if (!cs)
+        {
+            throw std::runtime_error("create compute shader failure");
+        }
+
+        _id = glCreateProgram();
+        if (_id == 0)
+        {
+            throw std::runtime_error("create shader program failure");
+        }
+
+        glAttachShader(_id, cs);
+
+        glLinkProgram(_id);
+
+        GLint success;
+        glGetProgramiv(_id, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            char buffer[1024];
+            glGetProgramInfoLog(_id, sizeof(buffer), NULL, buffer);
+            throw std::runtime_error("link program error: " + std::string(buffer));
+        }
+
+        glDeleteShader(cs);
+    }
+    catch (const std::exception &e)
+    {
+        if (cs)
+            glDeleteShader(cs);
+        if (_id)
+            glDeleteProgram(_id);
+        throw e;
+    }
+}
\ No newline at end of file
@@ -23,6 +23,11 @@ public:
      */
     Shader(const std::string &vsFilepath, const std::string &fsFilepath);
 
+    /*
+     * @brief constructor, read compute shader code from file to create opengl compute program
+     */
+    explicit Shader(const std::string &csFilepath);
+
     /*
      * @brief move constructor
      */
@@ -49,6 +54,11 @@ public:
      */
     void setInt(const std::string &name, int value) const;
 
+    /*
+     * @brief set uint uniform variable to shader
+     */
+    void setUint(const std::string &name, unsigned int value) const;
+
     /*
      * @brief set float uniform variable to shader
      */
@@ -84,7 +94,7 @@ private:
     GLuint _id = 0;
 
     /*
-     * @brief read shader code from file
+     * @brief read shader code from file, expanding #include "file" directives
      */
     std::string readFile(const std::string &filePath);
 
@@ -97,4 +107,9 @@ private:
      * @brief create a shader program
      */
     void createShaderProgram(const std::string &vsCode, const std::string &fsCode);
+
+    /*
+     * @brief create a compute shader program
+     */
+    void createComputeProgram(const std::string &csCode);
 };
\ No newline at end of file
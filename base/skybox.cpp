@@ -1,6 +1,6 @@
 #include "skybox.h"
 
-SkyBox::SkyBox(const std::vector<std::string>& textureFilenames) {
+SkyBox::SkyBox(const std::vector<std::string>& textureFilenames, bool mipmaps) {
 	GLfloat vertices[] = {
         -1.0f,  1.0f, -1.0f,
         -1.0f, -1.0f, -1.0f,
@@ -60,7 +60,7 @@ SkyBox::SkyBox(const std::vector<std::string>& textureFilenames) {
 
     try {
         // init texture
-        _texture.reset(new TextureCubemap(textureFilenames));
+        _texture.reset(new TextureCubemap(textureFilenames, mipmaps));
 
         const char* vertCode =
             "#version 330 core\n"
@@ -13,7 +13,7 @@
 
 class SkyBox {
 public:
-	SkyBox(const std::vector<std::string>& textureFilenames);
+	SkyBox(const std::vector<std::string>& textureFilenames, bool mipmaps = false);
 
 	~SkyBox();
 
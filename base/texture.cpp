@@ -1,6 +1,13 @@
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <type_traits>
 
 #include "texture.h"
+#include "thread_pool.h"
 #include <iostream>
 
 Texture::Texture()
@@ -28,19 +35,48 @@ void Texture::cleanup()
 	}
 }
 
-Texture2D::Texture2D(const std::string path) : _path(path)
+std::shared_ptr<DecodedImage> DecodeImage(const std::string &path, int desiredChannels)
 {
-	// load image to the memory
-	stbi_set_flip_vertically_on_load(true);
-	int width = 0, height = 0, channels = 0;
-	unsigned char *data = stbi_load(_path.c_str(), &width, &height, &channels, 0);
+	auto image = std::make_shared<DecodedImage>();
+	unsigned char *data = stbi_load(path.c_str(), &image->width, &image->height, &image->channels, desiredChannels);
 	if (data == nullptr)
 	{
-		glDeleteTextures(1, &_handle);
-		_handle = 0;
 		throw std::runtime_error("load " + path + " failure");
 	}
+	if (desiredChannels != 0)
+		image->channels = desiredChannels;
+
+	image->pixels.assign(data, data + (size_t)image->width * image->height * image->channels);
+	stbi_image_free(data);
+	return image;
+}
+
+Texture2D::Texture2D(const std::string path) : _path(path)
+{
+	std::shared_ptr<DecodedImage> image;
+	try
+	{
+		image = DecodeImage(_path);
+	}
+	catch (const std::exception &)
+	{
+		cleanup();
+		throw;
+	}
 
+	// flip vertically, OpenGL expects the bottom row first
+	size_t pitch = (size_t)image->width * image->channels;
+	for (int y = 0; y < image->height / 2; y++)
+	{
+		std::swap_ranges(image->pixels.begin() + y * pitch, image->pixels.begin() + (y + 1) * pitch,
+						 image->pixels.begin() + (image->height - 1 - y) * pitch);
+	}
+
+	upload(image->width, image->height, image->channels, image->pixels.data());
+}
+
+void Texture2D::upload(int width, int height, int channels, const void *data, GLenum type, bool mipmaps)
+{
 	// choose image format
 	GLenum format = GL_RGB;
 	switch (channels)
@@ -56,10 +92,23 @@ Texture2D::Texture2D(const std::string path) : _path(path)
 		break;
 	default:
 		cleanup();
-		stbi_image_free(data);
 		throw std::runtime_error("unsupported format");
 	}
 
+	// 16-bit and float data keep their precision on the gpu
+	GLint internalFormat = format;
+	size_t componentSize = sizeof(unsigned char);
+	if (type == GL_UNSIGNED_SHORT)
+	{
+		internalFormat = channels == 1 ? GL_R16 : (channels == 3 ? GL_RGB16 : GL_RGBA16);
+		componentSize = sizeof(unsigned short);
+	}
+	else if (type == GL_FLOAT)
+	{
+		internalFormat = channels == 1 ? GL_R16F : (channels == 3 ? GL_RGB16F : GL_RGBA16F);
+		componentSize = sizeof(float);
+	}
+
 	// set texture parameters
 	glBindTexture(GL_TEXTURE_2D, _handle);
 
@@ -70,7 +119,7 @@ Texture2D::Texture2D(const std::string path) : _path(path)
 	// transfer data to gpu
 	// 1. set alignment for data transfer
 	GLint alignment = 1;
-	size_t pitch = width * channels * sizeof(unsigned char);
+	size_t pitch = width * channels * componentSize;
 	if (pitch % 8 == 0)
 		alignment = 8;
 	else if (pitch % 4 == 0)
@@ -83,20 +132,58 @@ Texture2D::Texture2D(const std::string path) : _path(path)
 	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
 
 	// 2. transfer data
-	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, data);
 
 	// 3. restore alignment
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
 	// 4. mipmap settings
-	glGenerateMipmap(GL_TEXTURE_2D);
+	if (mipmaps)
+		glGenerateMipmap(GL_TEXTURE_2D);
 
 
 	// unbind texture
 	glBindTexture(GL_TEXTURE_2D, 0);
 
-	// free data
-	stbi_image_free(data);
+	GLenum error = glGetError();
+	if (error != GL_NO_ERROR)
+	{
+		std::stringstream ss;
+		ss << "texture object operation failure, (code " << error << ")";
+		cleanup();
+		throw std::runtime_error(ss.str());
+	}
+}
+
+void Texture2D::generateMipmaps()
+{
+	glBindTexture(GL_TEXTURE_2D, _handle);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	GLenum error = glGetError();
+	if (error != GL_NO_ERROR)
+	{
+		std::stringstream ss;
+		ss << "mipmap generation failure, (code " << error << ")";
+		throw std::runtime_error(ss.str());
+	}
+}
+
+void Texture3D::upload(int width, int height, int depth, const float *rgb)
+{
+	glBindTexture(GL_TEXTURE_3D, _handle);
+
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB16F, width, height, depth, 0, GL_RGB, GL_FLOAT, rgb);
+
+	glBindTexture(GL_TEXTURE_3D, 0);
 
 	GLenum error = glGetError();
 	if (error != GL_NO_ERROR)
@@ -108,6 +195,67 @@ Texture2D::Texture2D(const std::string path) : _path(path)
 	}
 }
 
+void Texture3D::bind() const
+{
+	glBindTexture(GL_TEXTURE_3D, _handle);
+}
+
+void Texture3D::unbind() const
+{
+	glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+void Texture2DArray::allocate(int width, int height, int layers, bool mipmaps)
+{
+	_width = width;
+	_height = height;
+	_mipmaps = mipmaps;
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, _handle);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, mipmaps ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, mipmaps ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, mipmaps ? GL_NEAREST_MIPMAP_NEAREST : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// every level is allocated up front, layers are filled as they become available
+	int levels = mipmaps ? 1 + (int)std::floor(std::log2((float)std::max(width, height))) : 1;
+	for (int level = 0; level < levels; level++)
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGB16F, std::max(1, width >> level), std::max(1, height >> level),
+			layers, 0, GL_RGB, GL_FLOAT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void Texture2DArray::uploadLayer(int layer, const float *rgb)
+{
+	glBindTexture(GL_TEXTURE_2D_ARRAY, _handle);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, _width, _height, 1, GL_RGB, GL_FLOAT, rgb);
+	if (_mipmaps)
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	GLenum error = glGetError();
+	if (error != GL_NO_ERROR)
+	{
+		std::stringstream ss;
+		ss << "texture object operation failure, (code " << error << ")";
+		cleanup();
+		throw std::runtime_error(ss.str());
+	}
+}
+
+void Texture2DArray::bind() const
+{
+	glBindTexture(GL_TEXTURE_2D_ARRAY, _handle);
+}
+
+void Texture2DArray::unbind() const
+{
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
 void Texture2D::bind() const
 {
 	glBindTexture(GL_TEXTURE_2D, _handle);
@@ -118,33 +266,149 @@ void Texture2D::unbind() const
 	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-TextureCubemap::TextureCubemap(const std::vector<std::string> &filenames)
+namespace
+{
+// one decoded cube face and its box filtered mips, level 0 first
+struct CubemapFace
+{
+	int width = 0;
+	int height = 0;
+	bool hdr = false;
+	std::vector<std::vector<unsigned char>> levels;
+	std::vector<std::vector<float>> hdrLevels;
+};
+
+template <typename T>
+void BuildFaceMips(std::vector<std::vector<T>> &levels, int width, int height)
+{
+	while (width > 1 || height > 1)
+	{
+		int w = std::max(1, width / 2), h = std::max(1, height / 2);
+		const std::vector<T> &fine = levels.back();
+		std::vector<T> coarse((size_t)w * h * 3);
+		for (int y = 0; y < h; y++)
+		for (int x = 0; x < w; x++)
+		for (int c = 0; c < 3; c++)
+		{
+			int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+			int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+			float sum = (float)fine[((size_t)y0 * width + x0) * 3 + c] + (float)fine[((size_t)y0 * width + x1) * 3 + c] +
+						(float)fine[((size_t)y1 * width + x0) * 3 + c] + (float)fine[((size_t)y1 * width + x1) * 3 + c];
+			coarse[((size_t)y * w + x) * 3 + c] = std::is_floating_point<T>::value ? (T)(0.25f * sum) : (T)(0.25f * sum + 0.5f);
+		}
+		levels.push_back(std::move(coarse));
+		width = w;
+		height = h;
+	}
+}
+
+CubemapFace DecodeCubemapFace(const std::string &path, bool mipmaps)
+{
+	CubemapFace face;
+	int channels = 0;
+	face.hdr = stbi_is_hdr(path.c_str()) != 0;
+	if (face.hdr)
+	{
+		float *data = stbi_loadf(path.c_str(), &face.width, &face.height, &channels, 3);
+		if (data == nullptr)
+			throw std::runtime_error("Cubemap texture failed to load at path: " + path);
+		face.hdrLevels.emplace_back(data, data + (size_t)face.width * face.height * 3);
+		stbi_image_free(data);
+		if (mipmaps)
+			BuildFaceMips(face.hdrLevels, face.width, face.height);
+	}
+	else
+	{
+		unsigned char *data = stbi_load(path.c_str(), &face.width, &face.height, &channels, 3);
+		if (data == nullptr)
+			throw std::runtime_error("Cubemap texture failed to load at path: " + path);
+		face.levels.emplace_back(data, data + (size_t)face.width * face.height * 3);
+		stbi_image_free(data);
+		if (mipmaps)
+			BuildFaceMips(face.levels, face.width, face.height);
+	}
+	return face;
+}
+}
+
+TextureCubemap::TextureCubemap(const std::vector<std::string> &filenames, bool mipmaps)
 	: _paths(filenames)
 {
 	assert(filenames.size() == 6);
-	// -----------------------------------------------
-	// write your code to generate texture cubemap
-	glBindTexture(GL_TEXTURE_CUBE_MAP, _handle);
-	int width = 0, height = 0, channels = 0;
 
-	for (unsigned int i = 0; i < _paths.size(); i++)
+	// decodes finish in any order, the GL thread uploads whichever face is ready
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::deque<int> decoded;
+	std::vector<std::future<CubemapFace>> faces;
 	{
-		unsigned char *data = stbi_load(_paths[i].c_str(), &width, &height, &channels, 0);
-		if (data)
+		ThreadPool pool(std::min(6u, std::max(1u, std::thread::hardware_concurrency())));
+		for (int i = 0; i < 6; i++)
+		{
+			faces.push_back(pool.submit([&, i]() {
+				struct Notify
+				{
+					std::mutex &mutex;
+					std::condition_variable &ready;
+					std::deque<int> &decoded;
+					int face;
+					~Notify()
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						decoded.push_back(face);
+						ready.notify_one();
+					}
+				} notify{mutex, ready, decoded, i};
+				return DecodeCubemapFace(_paths[i], mipmaps);
+			}));
+		}
+
+		glBindTexture(GL_TEXTURE_CUBE_MAP, _handle);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		std::string error;
+		for (int uploaded = 0; uploaded < 6; uploaded++)
 		{
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-			stbi_image_free(data);
+			int i;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				ready.wait(lock, [&] { return !decoded.empty(); });
+				i = decoded.front();
+				decoded.pop_front();
+			}
+
+			CubemapFace face;
+			try
+			{
+				face = faces[i].get();
+			}
+			catch (const std::exception &e)
+			{
+				error = e.what();
+				continue;
+			}
+
+			// the face goes to the driver while the other ones are still decoding
+			size_t levels = face.hdr ? face.hdrLevels.size() : face.levels.size();
+			for (size_t level = 0; level < levels; level++)
+			{
+				int w = std::max(1, face.width >> level), h = std::max(1, face.height >> level);
+				if (face.hdr)
+					glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, (GLint)level, GL_RGB16F, w, h, 0, GL_RGB, GL_FLOAT, face.hdrLevels[level].data());
+				else
+					glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, (GLint)level, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, face.levels[level].data());
+			}
 		}
-		else
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		if (!error.empty())
 		{
-			std::stringstream ss;
-			ss << "Cubemap texture failed to load at path: " << _paths[i];
-			stbi_image_free(data);
+			cleanup();
+			throw std::runtime_error(error);
 		}
 	}
 
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
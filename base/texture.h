@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <sstream>
 #include <vector>
@@ -7,6 +8,18 @@
 #include <glad/glad.h>
 #include "../external/stb/stb_image.h"
 
+// 8 bit image decoded by stb, rows are stored top to bottom as in the file
+struct DecodedImage
+{
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	std::vector<unsigned char> pixels;
+};
+
+// decode an image file, safe to call from any thread (no global stb state is used)
+std::shared_ptr<DecodedImage> DecodeImage(const std::string &path, int desiredChannels = 0);
+
 class Texture
 {
 public:
@@ -59,14 +72,79 @@ public:
 
 	virtual void unbind() const;
 
+	/*
+	 * @brief allocate level 0 from bottom-to-top rows and build the mipmaps,
+	 *        data is an offset when a GL_PIXEL_UNPACK_BUFFER is bound,
+	 *        type is GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_FLOAT;
+	 *        without mipmaps the chain is left to generateMipmaps()
+	 */
+	void upload(int width, int height, int channels, const void *data, GLenum type = GL_UNSIGNED_BYTE, bool mipmaps = true);
+
+	/*
+	 * @brief build the mip chain from level 0, e.g. once a PBO transfer has completed
+	 */
+	void generateMipmaps();
+
 private:
 	std::string _path;
 };
 
+// RGB volume with trilinear filtering and clamp to edge, e.g. a 3D LUT
+class Texture3D : public Texture
+{
+public:
+	Texture3D() = default;
+
+	~Texture3D() = default;
+
+	void bind() const override;
+
+	void unbind() const override;
+
+	/*
+	 * @brief allocate a width x height x depth RGB16F volume, x fastest
+	 */
+	void upload(int width, int height, int depth, const float *rgb);
+};
+
+// RGB16F layers of one size, e.g. the bands of an exemplar pyramid
+class Texture2DArray : public Texture
+{
+public:
+	Texture2DArray() = default;
+
+	~Texture2DArray() = default;
+
+	void bind() const override;
+
+	void unbind() const override;
+
+	/*
+	 * @brief allocate width x height x layers texels; with mipmaps it repeats and
+	 *        samples like Texture2D, without it clamps to edge with linear filtering
+	 */
+	void allocate(int width, int height, int layers, bool mipmaps);
+
+	/*
+	 * @brief upload one layer from bottom-to-top RGB rows, its mip chain is rebuilt
+	 */
+	void uploadLayer(int layer, const float *rgb);
+
+private:
+	int _width = 0;
+	int _height = 0;
+	bool _mipmaps = false;
+};
+
 class TextureCubemap : public Texture
 {
 public:
-	TextureCubemap(const std::vector<std::string> &filenames);
+	/*
+	 * @brief decode the six faces (+x, -x, +y, -y, +z, -z) concurrently and upload
+	 *        each one as soon as it is decoded; .hdr faces stay float (RGB16F),
+	 *        with mipmaps the mip chain of every face is filtered on its worker
+	 */
+	TextureCubemap(const std::vector<std::string> &filenames, bool mipmaps = false);
 
 	~TextureCubemap() = default;
 
@@ -0,0 +1,77 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads consuming a FIFO of tasks
+class ThreadPool
+{
+public:
+	explicit ThreadPool(unsigned numThreads = std::thread::hardware_concurrency())
+	{
+		if (numThreads == 0)
+			numThreads = 1;
+		for (unsigned i = 0; i < numThreads; i++)
+			_workers.emplace_back([this] { workerLoop(); });
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_condition.notify_all();
+		for (auto& worker : _workers)
+			worker.join();
+	}
+
+	unsigned size() const { return (unsigned)_workers.size(); }
+
+	// queue f, the future receives its result or exception
+	template <class F>
+	auto submit(F&& f) -> std::future<decltype(f())>
+	{
+		using Result = decltype(f());
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(f));
+		std::future<Result> future = task->get_future();
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_tasks.emplace_back([task] { (*task)(); });
+		}
+		_condition.notify_one();
+		return future;
+	}
+
+private:
+	std::vector<std::thread> _workers;
+	std::deque<std::function<void()>> _tasks;
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	bool _stop = false;
+
+	void workerLoop()
+	{
+		while (true)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_condition.wait(lock, [this] { return _stop || !_tasks.empty(); });
+				if (_stop && _tasks.empty())
+					return;
+				task = std::move(_tasks.front());
+				_tasks.pop_front();
+			}
+			task();
+		}
+	}
+};
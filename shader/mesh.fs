@@ -0,0 +1,127 @@
+#version 400 core
+
+// synth.fs on a mesh: the blend runs on three planar projections of the world
+// position and the projections are combined in gaussian space, so the
+// variance-preserving normalization also hides the triplanar transitions.
+out vec4 FragColor;
+in vec3 WorldPosition;
+in vec3 WorldNormal;
+uniform sampler2D src_texture;
+uniform sampler2D gauss_texture;
+uniform sampler2D inv_lut_texture;
+uniform sampler3D inv_lut3d_texture;
+
+uniform int blendMode = 2;
+// exemplar repeats per world unit
+uniform float noiseScale = 1.0;
+// higher is a sharper transition between projections
+uniform float triplanarSharpness = 4.0;
+// projections with a smaller weight are skipped, the others renormalized
+uniform float triplanarCutoff = 0.05;
+#include "synth_common.glsl"
+
+vec3 fetch(vec2 uv, vec2 duvdx, vec2 duvdy) {
+	// without OT, direct apply interpolation
+	if(blendMode==0||blendMode==1||blendMode==3)
+		return (textureGrad(src_texture, uv, duvdx, duvdy).rgb);
+
+	return (textureGrad(gauss_texture, uv, duvdx, duvdy).rgb);
+}
+
+// triangle-grid blend of one projection, before normalization
+vec3 blendProjection(vec2 uv, vec2 duvdx, vec2 duvdy, out float weightNorm)
+{
+	weightNorm = 1.0;
+
+	//source or gaussian picture
+	if(blendMode==3||blendMode==4)
+		return fetch(uv, duvdx, duvdy);
+
+	float w1, w2, w3;
+	ivec2 vertex1, vertex2, vertex3;
+	TriangleGrid(uv, w1, w2, w3, vertex1, vertex2, vertex3);
+
+	// seam-aware and precomputed offsets as in synth.fs, each window with its own derivatives
+	vec2 duvdx1 = duvdx, duvdy1 = duvdy;
+	vec2 duvdx2 = duvdx, duvdy2 = duvdy;
+	vec2 duvdx3 = duvdx, duvdy3 = duvdy;
+	vec2 uv1 = vertexSample(vertex1, uv, duvdx1, duvdy1);
+	vec2 uv2 = vertexSample(vertex2, uv, duvdx2, duvdy2);
+	vec2 uv3 = vertexSample(vertex3, uv, duvdx3, duvdy3);
+	vec3 G1 = fetch(uv1, duvdx1, duvdy1);
+	vec3 G2 = fetch(uv2, duvdx2, duvdy2);
+	vec3 G3 = fetch(uv3, duvdx3, duvdy3);
+	weightNorm = sqrt(w1*w1 + w2*w2 + w3*w3);
+	return w1*G1 + w2*G2 + w3*G3;
+}
+
+void main() {
+	// meshes without vn fall back to the face normal
+	vec3 faceNormal = cross(dFdx(WorldPosition), dFdy(WorldPosition));
+	vec3 n = normalize(dot(WorldNormal, WorldNormal) > 1e-12 ? WorldNormal : faceNormal);
+	vec3 weights = pow(abs(n), vec3(triplanarSharpness));
+	weights /= dot(weights, vec3(1.0));
+	// projections facing away contribute little, skip their fetches
+	weights *= step(vec3(triplanarCutoff), weights);
+	weights /= dot(weights, vec3(1.0));
+
+	vec3 p = WorldPosition * noiseScale;
+	vec2 uvs[3] = vec2[3](p.yz, p.xz, p.xy);
+	// derivatives taken in uniform control flow, before projections are skipped
+	vec3 dpdx = dFdx(p);
+	vec3 dpdy = dFdy(p);
+	vec2 duvdx[3] = vec2[3](dpdx.yz, dpdx.xz, dpdx.xy);
+	vec2 duvdy[3] = vec2[3](dpdy.yz, dpdy.xz, dpdy.xy);
+
+	// the linear part of every blend adds up, the normalizations combine as one
+	vec3 G_upper = vec3(0.0);
+	vec3 G_centered = vec3(0.0);
+	float variance = 0.0;
+	float footprint = 0.0;
+	for(int axis = 0; axis < 3; axis++)
+	{
+		if(weights[axis] == 0.0)
+			continue;
+		float weightNorm;
+		vec3 G = blendProjection(uvs[axis], duvdx[axis], duvdy[axis], weightNorm);
+		G_upper += weights[axis] * G;
+		G_centered += weights[axis] * (G - vec3(0.5)) / weightNorm;
+		variance += weights[axis] * weights[axis];
+		footprint += weights[axis] * max(length(duvdx[axis]), length(duvdy[axis]));
+	}
+
+	//linear blend, source or gaussian picture
+	if(blendMode==0||blendMode==3||blendMode==4)
+	{
+		FragColor = vec4(G_upper, 1.0);
+		return;
+	}
+
+	// each projection has unit variance once normalized, so does their normalized sum
+	vec3 G_cov = clamp(G_centered * inversesqrt(variance) + vec3(0.5), 0.0, 1.0);
+
+	//variance blend or gaussian blend
+	if(blendMode==1 || blendMode==5)
+	{
+		FragColor = vec4(G_cov, 1.0);
+		return;
+	}
+
+	//joint inverse LUT
+	if(blendMode==6)
+	{
+		FragColor = vec4(texture(inv_lut3d_texture, G_cov).rgb, 1.0);
+		return;
+	}
+
+	//inverse LUT
+	vec3 color;
+	// LOD of the weighted footprint, same row choice as textureQueryLod in synth.fs
+	float level = max(0.0, log2(footprint * float(textureSize(gauss_texture, 0).x)));
+	int lutRows = textureSize(inv_lut_texture, 0).y;
+	float LOD = (float(min(int(level), lutRows - 1)) + 0.5) / float(lutRows);
+	color.r = texture(inv_lut_texture, vec2(G_cov.r, LOD)).r;
+	color.g = texture(inv_lut_texture, vec2(G_cov.g, LOD)).g;
+	color.b = texture(inv_lut_texture, vec2(G_cov.b, LOD)).b;
+	FragColor = vec4(ReturnToOriginalColorSpace(color), 1.0);
+}
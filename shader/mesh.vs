@@ -0,0 +1,19 @@
+#version 400 core
+layout (location = 0) in vec3 aPosition;
+layout (location = 1) in vec3 aNormal;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec3 WorldPosition;
+out vec3 WorldNormal;
+
+void main()
+{
+	vec4 world = model * vec4(aPosition, 1.0);
+	WorldPosition = world.xyz;
+	// inverse transpose, normals stay perpendicular to the surface under non-uniform scale
+	WorldNormal = transpose(inverse(mat3(model))) * aNormal;
+	gl_Position = projection * view * world;
+}
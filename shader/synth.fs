@@ -6,91 +6,29 @@ uniform sampler2D src_texture;
 uniform sampler2D gauss_texture;
 uniform sampler2D inv_lut_texture;
 // inverse transformation LUT
+uniform sampler3D inv_lut3d_texture;
+// joint RGB inverse transformation, blendMode 6
+uniform sampler2DArray band_gauss_texture;
+uniform sampler2DArray band_lut_texture;
+// Gaussianized pyramid bands and their inverse LUTs, blendMode 7
+
+// pyramid bands [firstBand, bandCount) are blended, band k on a grid 2^k times coarser
+uniform int bandCount = 0;
+uniform int firstBand = 0;
+uniform vec3 bandVec1[4];
+uniform vec3 bandVec2[4];
+uniform vec3 bandVec3[4];
+uniform vec3 bandOrigin[4];
+// contrast of the summed bands, see ExemplarPyramid
+uniform vec3 bandMean = vec3(0.0);
+uniform vec3 bandGain = vec3(1.0);
 
 uniform float aspect_ratio = 1.0f;
 uniform int blendMode = 0;
-// Decorrelated color space vectors and origin
-uniform vec3 _colorSpaceVec1;
-uniform vec3 _colorSpaceVec2;
-uniform vec3 _colorSpaceVec3;
-uniform vec3 _colorSpaceOrigin;
-
-vec3 ReturnToOriginalColorSpace(vec3 color)
-{
-	vec3 result = 
-		_colorSpaceOrigin +
-		_colorSpaceVec1 * color.r +
-		_colorSpaceVec2 * color.g +
-		_colorSpaceVec3 * color.b;
-	return result;
-}
-
-// Approximate error function (erf) in GLSL
-float erf(float x) {
-    // Abramowitz & Stegun approximation coefficients
-    float p = 0.278393;
-    float q = 0.230389;
-    float r = 0.000972;
-    float s = 0.078108;
-
-    // Absolute value of x (erf is an odd function)
-    float t = abs(x);
-
-    // The approximation formula
-    float approximation = 1.0 - (1.0 / pow((1.0 + p * t + q * t * t + r * t * t * t + s * t * t * t * t), 4.0));
-
-    // Adjust sign based on the sign of the input
-    if (x < 0.0) {
-        return -approximation;
-    } else {
-        return approximation;
-    }
-}
-
-vec3 erf(vec3 x) {
-    return vec3(erf(x.x), erf(x.y), erf(x.z));
-}
-
-vec2 hash( vec2 p ) {
-    return fract(sin((p)*mat2(127.1,311.7,269.5,183.3))*43758.5453);
-}
-
-// Compute local triangle barycentric coordinates and vertex IDs
-void TriangleGrid(vec2 uv,
-	out float w1, out float w2, out float w3,
-	out ivec2 vertex1, out ivec2 vertex2, out ivec2 vertex3)
-{
-	// Scaling of the input
-	uv *= 3.464; // 2 * sqrt(3)
-
-	// Skew input space into simplex triangle grid
-	const mat2 gridToSkewedGrid = mat2(1.0, 0.0, -0.57735027, 1.15470054);
-	vec2 skewedCoord = gridToSkewedGrid * uv;
-
-	// Compute local triangle vertex IDs and local barycentric coordinates
-	ivec2 baseId = ivec2(floor(skewedCoord));
-	vec3 temp = vec3(fract(skewedCoord), 0);
-	temp.z = 1.0 - temp.x - temp.y;
-	if (temp.z > 0.0)
-	{
-		w1 = temp.z;
-		w2 = temp.y;
-		w3 = temp.x;
-		vertex1 = baseId;
-		vertex2 = baseId + ivec2(0, 1);
-		vertex3 = baseId + ivec2(1, 0);
-	}
-	else
-	{
-		w1 = -temp.z;
-		w2 = 1.0 - temp.y;
-		w3 = 1.0 - temp.x;
-		vertex1 = baseId + ivec2(1, 1);
-		vertex2 = baseId + ivec2(1, 0);
-		vertex3 = baseId + ivec2(0, 1);
-	}
-}
-
+// animated noise blends over a space-time simplex lattice at (uv, time)
+uniform int animate = 0;
+uniform float time = 0.0;
+#include "synth_common.glsl"
 
 vec3 fetch(vec2 uv, vec2 duvdx, vec2 duvdy) {
 	// without OT, direct apply interpolation
@@ -119,30 +57,75 @@ void main() {
 		return;
 	}
 
-    float w1, w2, w3;
-	ivec2 vertex1, vertex2, vertex3;
-    TriangleGrid(uv, w1, w2, w3, vertex1, vertex2, vertex3);
-
-    // Assign random offset to each triangle vertex
-	vec2 uv1 = uv + hash(vertex1);
-	vec2 uv2 = uv + hash(vertex2);
-	vec2 uv3 = uv + hash(vertex3);
-
 	// Precompute UV derivatives 
 	vec2 duvdx = dFdx(uv);
 	vec2 duvdy = dFdy(uv);
 
-	// Fetch Gaussian input
-	vec3 G1 = fetch(uv1, duvdx, duvdy).rgb;
-	vec3 G2 = fetch(uv2, duvdx, duvdy).rgb;
-	vec3 G3 = fetch(uv3, duvdx, duvdy).rgb;
+	//multi-scale, the bands summed back like SynthesizeMultiScale
+	if(blendMode==7)
+	{
+		vec3 color = vec3(0.0);
+		for(int band = firstBand; band < bandCount; band++)
+		{
+			float w1, w2, w3;
+			ivec2 vertex1, vertex2, vertex3;
+			// uv starts at 0 here, the coarser grids share the zero origin
+			TriangleGrid(uv * exp2(-float(band)), ivec2(0), vec2(0.0), w1, w2, w3, vertex1, vertex2, vertex3);
+
+			// plain hash: every band needs its own offsets, the seam-aware and precomputed tables are not used
+			uint seed = hashSeed + uint(band) * 0x632BE5ABu;
+			vec3 G1 = textureGrad(band_gauss_texture, vec3(uv + hash(vertex1, seed), band), duvdx, duvdy).rgb;
+			vec3 G2 = textureGrad(band_gauss_texture, vec3(uv + hash(vertex2, seed), band), duvdx, duvdy).rgb;
+			vec3 G3 = textureGrad(band_gauss_texture, vec3(uv + hash(vertex3, seed), band), duvdx, duvdy).rgb;
+			vec3 G_cov = VariancePreservingBlend(w1*G1 + w2*G2 + w3*G3, w1, w2, w3);
+
+			vec3 value;
+			value.r = texture(band_lut_texture, vec3(G_cov.r, 0.5, band)).r;
+			value.g = texture(band_lut_texture, vec3(G_cov.g, 0.5, band)).g;
+			value.b = texture(band_lut_texture, vec3(G_cov.b, 0.5, band)).b;
+			color += bandOrigin[band] + bandVec1[band] * value.r + bandVec2[band] * value.g + bandVec3[band] * value.b;
+		}
+		color = bandMean + bandGain * (color - bandMean);
+		FragColor = vec4(clamp(color, 0.0, 1.0), 1.0);
+		return;
+	}
 
-	vec3 avg = vec3(0.5);
-    vec3 G_upper = w1*G1 + w2*G2 + w3*G3;
-	vec3 G_cov = G_upper - avg;
-	G_cov = G_cov * inversesqrt(w1*w1 + w2*w2 + w3*w3);
-	G_cov = G_cov + avg;
-    G_cov = clamp(G_cov,0.0,1.0);
+	vec3 G_upper, G_cov;
+	if(animate!=0)
+	{
+		// four tetrahedron vertices in (u, v, t), each one a 2D offset of the exemplar;
+		// the seam-aware and precomputed tables are indexed by 2D vertices and not used here
+		vec4 w;
+		ivec3 vertex[4];
+		TetrahedralGrid(vec3(uv, time), w, vertex);
+
+		G_upper = vec3(0.0);
+		for(int i = 0; i < 4; i++)
+			G_upper += w[i] * fetch(uv + hashOffset(hash3(vertex[i])).xy, duvdx, duvdy);
+		G_cov = VariancePreservingBlend(G_upper, w);
+	}
+	else
+	{
+		float w1, w2, w3;
+		ivec2 vertex1, vertex2, vertex3;
+		TriangleGrid(uv, w1, w2, w3, vertex1, vertex2, vertex3);
+
+		// Assign random offset to each triangle vertex
+		vec2 duvdx1 = duvdx, duvdy1 = duvdy;
+		vec2 duvdx2 = duvdx, duvdy2 = duvdy;
+		vec2 duvdx3 = duvdx, duvdy3 = duvdy;
+		vec2 uv1 = vertexSample(vertex1, uv, duvdx1, duvdy1);
+		vec2 uv2 = vertexSample(vertex2, uv, duvdx2, duvdy2);
+		vec2 uv3 = vertexSample(vertex3, uv, duvdx3, duvdy3);
+
+		// Fetch Gaussian input
+		vec3 G1 = fetch(uv1, duvdx1, duvdy1).rgb;
+		vec3 G2 = fetch(uv2, duvdx2, duvdy2).rgb;
+		vec3 G3 = fetch(uv3, duvdx3, duvdy3).rgb;
+
+		G_upper = w1*G1 + w2*G2 + w3*G3;
+		G_cov = VariancePreservingBlend(G_upper, w1, w2, w3);
+	}
 
 	//linear blend
     if(blendMode==0)
@@ -159,9 +142,18 @@ void main() {
 	}
 
 
+	//joint inverse LUT, texel centers line up with the cell centers under clamp to edge
+	if(blendMode==6)
+	{
+		FragColor = vec4(texture(inv_lut3d_texture, G_cov).rgb, 1.0);
+		return;
+	}
+
 	//inverse LUT
 	vec3 color;
-	float LOD = textureQueryLod(gauss_texture, uv).y / float(textureSize(inv_lut_texture, 0).y);
+	// center of the prefiltered row of the LOD, the row choice of synth.comp and the CPU LookupLUT
+	int lutRows = textureSize(inv_lut_texture, 0).y;
+	float LOD = (float(clamp(int(textureQueryLod(gauss_texture, uv).y), 0, lutRows - 1)) + 0.5) / float(lutRows);
 
 	color.r = texture(inv_lut_texture, vec2(G_cov.r, LOD)).r;
 	color.g	= texture(inv_lut_texture, vec2(G_cov.g, LOD)).g;
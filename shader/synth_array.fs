@@ -0,0 +1,105 @@
+#version 400 core
+
+// synth.fs for a whole exemplar library, the layer comes from the instance
+out vec4 FragColor;
+in vec2 TexCoord;
+flat in int Layer;
+uniform sampler2DArray src_texture;
+uniform sampler2DArray gauss_texture;
+uniform sampler2DArray inv_lut_texture;
+
+uniform float aspect_ratio = 1.0f;
+uniform int blendMode = 0;
+#include "synth_common.glsl"
+
+#define MAX_LIBRARY_EXEMPLARS 64
+struct ColorSpace
+{
+	vec4 vec1;
+	vec4 vec2;
+	vec4 vec3;
+	vec4 origin;
+};
+
+layout(std140) uniform ExemplarColorSpaces
+{
+	ColorSpace colorSpaces[MAX_LIBRARY_EXEMPLARS];
+};
+
+vec3 ReturnToOriginalColorSpace(vec3 color, int layer)
+{
+	ColorSpace cs = colorSpaces[layer];
+	return cs.origin.xyz + cs.vec1.xyz * color.r + cs.vec2.xyz * color.g + cs.vec3.xyz * color.b;
+}
+
+vec3 fetch(vec2 uv, vec2 duvdx, vec2 duvdy) {
+	// without OT, direct apply interpolation
+	if(blendMode==0||blendMode==1)
+		return (textureGrad(src_texture, vec3(uv, Layer), duvdx, duvdy).rgb);
+
+	return (textureGrad(gauss_texture, vec3(uv, Layer), duvdx, duvdy).rgb);
+}
+
+void main() {
+
+	vec2 uv = TexCoord;
+	uv.x *= aspect_ratio;
+
+	//source picture
+	if(blendMode==3)
+	{
+		FragColor = vec4(texture(src_texture, vec3(uv, Layer)).rgb, 1.0);
+		return;
+	}
+
+	//gaussian picture
+	if(blendMode==4)
+	{
+		FragColor = vec4(texture(gauss_texture, vec3(uv, Layer)).rgb, 1.0);
+		return;
+	}
+
+	float w1, w2, w3;
+	ivec2 vertex1, vertex2, vertex3;
+	TriangleGrid(uv, w1, w2, w3, vertex1, vertex2, vertex3);
+
+	// Assign random offset to each triangle vertex
+	vec2 uv1 = uv + hash(vertex1);
+	vec2 uv2 = uv + hash(vertex2);
+	vec2 uv3 = uv + hash(vertex3);
+
+	// Precompute UV derivatives
+	vec2 duvdx = dFdx(uv);
+	vec2 duvdy = dFdy(uv);
+
+	// Fetch Gaussian input
+	vec3 G1 = fetch(uv1, duvdx, duvdy);
+	vec3 G2 = fetch(uv2, duvdx, duvdy);
+	vec3 G3 = fetch(uv3, duvdx, duvdy);
+
+	vec3 G_upper = w1*G1 + w2*G2 + w3*G3;
+	vec3 G_cov = VariancePreservingBlend(G_upper, w1, w2, w3);
+
+	//linear blend
+	if(blendMode==0)
+	{
+		FragColor = vec4(G_upper, 1.0);
+		return;
+	}
+
+	//variance blend or gaussian blend
+	if(blendMode==1 || blendMode==5)
+	{
+		FragColor = vec4(G_cov, 1.0);
+		return;
+	}
+
+	//inverse LUT
+	vec3 color;
+	float LOD = textureQueryLod(gauss_texture, uv).y / float(textureSize(inv_lut_texture, 0).y);
+
+	color.r = texture(inv_lut_texture, vec3(G_cov.r, LOD, Layer)).r;
+	color.g = texture(inv_lut_texture, vec3(G_cov.g, LOD, Layer)).g;
+	color.b = texture(inv_lut_texture, vec3(G_cov.b, LOD, Layer)).b;
+	FragColor = vec4(ReturnToOriginalColorSpace(color, Layer), 1.0);
+}
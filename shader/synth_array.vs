@@ -0,0 +1,20 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec2 aTexCoords;
+
+out vec2 TexCoord;
+flat out int Layer;
+
+// number of cells of the grid the library is laid out in
+uniform ivec2 gridSize;
+
+void main() {
+    // one instance per exemplar, each instance covers one cell of the grid
+    ivec2 cell = ivec2(gl_InstanceID % gridSize.x, gl_InstanceID / gridSize.x);
+    vec2 cellMin = vec2(cell) / vec2(gridSize);
+    vec2 pos = (cellMin + aTexCoords / vec2(gridSize)) * 2.0 - 1.0;
+
+    TexCoord = aTexCoords;
+    Layer = gl_InstanceID;
+    gl_Position = vec4(pos, 0.0, 1.0);
+}
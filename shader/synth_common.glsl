@@ -0,0 +1,255 @@
+// Shared by the synthesis shaders, included after the #version line
+
+// Decorrelated color space vectors and origin
+uniform vec3 _colorSpaceVec1;
+uniform vec3 _colorSpaceVec2;
+uniform vec3 _colorSpaceVec3;
+uniform vec3 _colorSpaceOrigin;
+
+vec3 ReturnToOriginalColorSpace(vec3 color)
+{
+	vec3 result = 
+		_colorSpaceOrigin +
+		_colorSpaceVec1 * color.r +
+		_colorSpaceVec2 * color.g +
+		_colorSpaceVec3 * color.b;
+	return result;
+}
+
+// Approximate error function (erf) in GLSL
+float erf(float x) {
+    // Abramowitz & Stegun approximation coefficients
+    float p = 0.278393;
+    float q = 0.230389;
+    float r = 0.000972;
+    float s = 0.078108;
+
+    // Absolute value of x (erf is an odd function)
+    float t = abs(x);
+
+    // The approximation formula
+    float approximation = 1.0 - (1.0 / pow((1.0 + p * t + q * t * t + r * t * t * t + s * t * t * t * t), 4.0));
+
+    // Adjust sign based on the sign of the input
+    if (x < 0.0) {
+        return -approximation;
+    } else {
+        return approximation;
+    }
+}
+
+vec3 erf(vec3 x) {
+    return vec3(erf(x.x), erf(x.y), erf(x.z));
+}
+
+// Seed of the per-vertex offsets
+uniform uint hashSeed = 0u;
+
+// PCG2D (Jarzynski & Olano 2020), integer only so the C++ Hash matches it bit for bit
+uvec2 pcg2d(uvec2 v)
+{
+	v = v * 1664525u + 1013904223u;
+	v.x += v.y * 1664525u;
+	v.y += v.x * 1664525u;
+	v = v ^ (v >> 16u);
+	v.x += v.y * 1664525u;
+	v.y += v.x * 1664525u;
+	v = v ^ (v >> 16u);
+	return v;
+}
+
+// Random offset of a vertex in [0, 1), 24-bit fractions are exact in float
+vec2 hash(ivec2 p, uint seed)
+{
+	uvec2 h = pcg2d(uvec2(p) + seed * uvec2(0x9E3779B9u, 0x85EBCA6Bu));
+	return vec2(h >> 8u) * (1.0 / 16777216.0);
+}
+
+vec2 hash(ivec2 p)
+{
+	return hash(p, hashSeed);
+}
+
+// Integer part of the uv origin, skewed on the CPU in double precision
+// (ComputeGridOrigin): the grid vertex it falls in and the remainder.
+// uv given to TriangleGrid is relative to that origin.
+uniform ivec2 gridOriginVertex = ivec2(0);
+uniform vec2 gridOriginFraction = vec2(0.0);
+
+// Compute local triangle barycentric coordinates and vertex IDs, uv relative to the given origin
+void TriangleGrid(vec2 uv, ivec2 originVertex, vec2 originFraction,
+	out float w1, out float w2, out float w3,
+	out ivec2 vertex1, out ivec2 vertex2, out ivec2 vertex3)
+{
+	// Scaling of the input
+	uv *= 3.464; // 2 * sqrt(3)
+
+	// Skew input space into simplex triangle grid
+	const mat2 gridToSkewedGrid = mat2(1.0, 0.0, -0.57735027, 1.15470054);
+	vec2 skewedCoord = gridToSkewedGrid * uv + originFraction;
+
+	// Compute local triangle vertex IDs and local barycentric coordinates
+	ivec2 baseId = originVertex + ivec2(floor(skewedCoord));
+	vec3 temp = vec3(fract(skewedCoord), 0);
+	temp.z = 1.0 - temp.x - temp.y;
+	if (temp.z > 0.0)
+	{
+		w1 = temp.z;
+		w2 = temp.y;
+		w3 = temp.x;
+		vertex1 = baseId;
+		vertex2 = baseId + ivec2(0, 1);
+		vertex3 = baseId + ivec2(1, 0);
+	}
+	else
+	{
+		w1 = -temp.z;
+		w2 = 1.0 - temp.y;
+		w3 = 1.0 - temp.x;
+		vertex1 = baseId + ivec2(1, 1);
+		vertex2 = baseId + ivec2(1, 0);
+		vertex3 = baseId + ivec2(0, 1);
+	}
+}
+
+void TriangleGrid(vec2 uv,
+	out float w1, out float w2, out float w3,
+	out ivec2 vertex1, out ivec2 vertex2, out ivec2 vertex3)
+{
+	TriangleGrid(uv, gridOriginVertex, gridOriginFraction, w1, w2, w3, vertex1, vertex2, vertex3);
+}
+
+// uv of a grid vertex relative to the grid origin, inverse of the skew in TriangleGrid
+vec2 VertexUV(ivec2 vertex)
+{
+	vec2 skewed = vec2(vertex - gridOriginVertex) - gridOriginFraction;
+	return vec2(skewed.x + 0.5 * skewed.y, 0.8660254 * skewed.y) / 3.464;
+}
+
+// Seam-aware offsets (SeamOffsetTable): 1024 x 1 lower corners of the 1/32
+// cells whose windows stay clear of the exemplar seams
+uniform int seamAware = 0;
+uniform sampler2D seam_offset_texture;
+
+// Offset h in [0, 1)^2 of a vertex remapped so its window is centered in a good cell
+vec2 seamAwareOffset(ivec2 vertex, vec2 h)
+{
+	float entry = h.x * 1024.0;
+	vec2 cell = texelFetch(seam_offset_texture, ivec2(int(entry), 0), 0).rg;
+	return cell + vec2(fract(entry), h.y) * (1.0 / 32.0) - VertexUV(vertex);
+}
+
+// Offset of a vertex, hash() remapped by the seam-aware table
+vec2 vertexOffset(ivec2 vertex)
+{
+	vec2 h = hash(vertex);
+	return seamAware != 0 ? seamAwareOffset(vertex, h) : h;
+}
+
+// Precomputed per-vertex offsets (VertexOffsetTable): a wrapping RGBA32F table
+// indexed by vertex ID, offset in rg and the window transform s * (cos, sin) in ba
+uniform int offsetTable = 0;
+uniform sampler2D vertex_offset_texture;
+
+// Where a vertex samples the exemplar for the pixel at uv; with the table the
+// window is rotated and scaled around the vertex, the derivatives along with it
+vec2 vertexSample(ivec2 vertex, vec2 uv, inout vec2 duvdx, inout vec2 duvdy)
+{
+	if(offsetTable == 0)
+		return uv + vertexOffset(vertex);
+
+	uvec2 mask = uvec2(textureSize(vertex_offset_texture, 0) - 1);
+	vec4 texel = texelFetch(vertex_offset_texture, ivec2(uvec2(vertex) & mask), 0);
+	vec2 offset = seamAware != 0 ? seamAwareOffset(vertex, texel.xy) : texel.xy;
+	mat2 window = mat2(texel.z, texel.w, -texel.w, texel.z);
+	vec2 center = VertexUV(vertex);
+	duvdx = window * duvdx;
+	duvdy = window * duvdy;
+	return center + offset + window * (uv - center);
+}
+
+// Variance-preserving blend of the linearly interpolated Gaussian values
+vec3 VariancePreservingBlend(vec3 G_upper, float w1, float w2, float w3)
+{
+	vec3 avg = vec3(0.5);
+	vec3 G_cov = G_upper - avg;
+	G_cov = G_cov * inversesqrt(w1*w1 + w2*w2 + w3*w3);
+	G_cov = G_cov + avg;
+	return clamp(G_cov, 0.0, 1.0);
+}
+
+// PCG3D (Jarzynski & Olano 2020), matches Pcg3d in SynthCPU.hpp
+uvec3 pcg3d(uvec3 v)
+{
+	v = v * 1664525u + 1013904223u;
+	v.x += v.y * v.z;
+	v.y += v.z * v.x;
+	v.z += v.x * v.y;
+	v = v ^ (v >> 16u);
+	v.x += v.y * v.z;
+	v.y += v.z * v.x;
+	v.z += v.x * v.y;
+	return v;
+}
+
+// Random bits of a tetrahedral grid vertex
+uvec3 hash3(ivec3 p)
+{
+	return pcg3d(uvec3(p) + hashSeed * uvec3(0x9E3779B9u, 0x85EBCA6Bu, 0xC2B2AE35u));
+}
+
+// Random offset in [0, 1) from the bits of hash3, 24-bit fractions are exact in float
+vec3 hashOffset(uvec3 h)
+{
+	return vec3(h >> 8u) * (1.0 / 16777216.0);
+}
+
+// 3D version of TriangleGrid: the skewed cubic grid is cut into six tetrahedra
+// along its main diagonal (Kuhn), the sorted fractions give the barycentrics
+void TetrahedralGrid(vec3 p, out vec4 w, out ivec3 vertex[4])
+{
+	// Scaling of the input, same density as the triangle grid
+	p *= 3.464;
+
+	// Skew input space into simplex grid
+	vec3 skewedCoord = p + (p.x + p.y + p.z) * (1.0 / 3.0);
+	ivec3 baseId = ivec3(floor(skewedCoord));
+	vec3 f = skewedCoord - vec3(baseId);
+
+	// Order the axes by decreasing fraction
+	ivec3 first, second;
+	vec3 sorted;
+	if (f.x >= f.y)
+	{
+		if (f.y >= f.z)      { first = ivec3(1, 0, 0); second = ivec3(0, 1, 0); sorted = f.xyz; }
+		else if (f.x >= f.z) { first = ivec3(1, 0, 0); second = ivec3(0, 0, 1); sorted = f.xzy; }
+		else                 { first = ivec3(0, 0, 1); second = ivec3(1, 0, 0); sorted = f.zxy; }
+	}
+	else
+	{
+		if (f.y < f.z)       { first = ivec3(0, 0, 1); second = ivec3(0, 1, 0); sorted = f.zyx; }
+		else if (f.x < f.z)  { first = ivec3(0, 1, 0); second = ivec3(0, 0, 1); sorted = f.yzx; }
+		else                 { first = ivec3(0, 1, 0); second = ivec3(1, 0, 0); sorted = f.yxz; }
+	}
+
+	w = vec4(1.0 - sorted.x, sorted.x - sorted.y, sorted.y - sorted.z, sorted.z);
+	vertex[0] = baseId;
+	vertex[1] = baseId + first;
+	vertex[2] = baseId + first + second;
+	vertex[3] = baseId + ivec3(1);
+}
+
+// Planar projection of a 3D position chosen per vertex, so 2D exemplars can fill a volume
+vec2 ProjectVertex(vec3 p, uvec3 h)
+{
+	uint axis = ((h.z >> 8u) * 3u) >> 24u;
+	vec2 planar = axis == 0u ? p.yz : (axis == 1u ? p.xz : p.xy);
+	return planar + hashOffset(h).xy;
+}
+
+// Variance-preserving blend over the four tetrahedron vertices
+vec3 VariancePreservingBlend(vec3 G_upper, vec4 w)
+{
+	vec3 G_cov = (G_upper - vec3(0.5)) * inversesqrt(dot(w, w)) + vec3(0.5);
+	return clamp(G_cov, 0.0, 1.0);
+}
@@ -0,0 +1,308 @@
+#include "NoiseSynth.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include <opencv2/opencv.hpp>
+#include "GoldenImage.hpp"
+#include "VolumeBake.hpp"
+
+bool NoiseSynth::bakeCompute(int width, int height, const std::string& filename)
+{
+    if(!_computeSynth)
+    {
+        std::cerr << "Compute synthesis is not supported by this context" << std::endl;
+        return false;
+    }
+    if(!waitForExemplar())
+        return false;
+
+    glActiveTexture(GL_TEXTURE0);
+    _noiseTexture->bind();
+    glActiveTexture(GL_TEXTURE1);
+    _gaussianTexture->bind();
+    glActiveTexture(GL_TEXTURE2);
+    _invLutTexture->bind();
+
+    // the 3D LUT is built in the background, wait for it; without one the per channel LUT stands in
+    int mode = blendMode;
+    if(mode == 6)
+    {
+        while(!updateLUT3D() && _pendingLUT3D.valid())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        if(updateLUT3D())
+        {
+            glActiveTexture(GL_TEXTURE5);
+            _invLut3DTexture->bind();
+        }
+        else
+        {
+            std::cerr << "No 3D LUT, baking with the per channel LUT" << std::endl;
+            mode = 2;
+        }
+    }
+    // so are the pyramid bands, all of them since one texel per pixel resolves every band
+    int firstBand = -1;
+    if(mode == 7)
+    {
+        int band = FirstVisibleBand(0.0f, MAX_PYRAMID_BANDS);
+        while((firstBand = updatePyramid(band)) != band && _pendingPyramid.valid())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        if(firstBand < 0)
+        {
+            std::cerr << "No pyramid bands, baking with the per channel LUT" << std::endl;
+            mode = 2;
+        }
+    }
+
+    _computeSynth->shader().use();
+    _computeSynth->shader().setInt("blendMode", mode);
+    if(firstBand >= 0)
+        bindPyramid(_computeSynth->shader(), firstBand, GL_TEXTURE6, GL_TEXTURE7);
+    _computeSynth->shader().setUint("hashSeed", (unsigned int)hashSeed);
+    bindSeamOffsets(_computeSynth->shader(), GL_TEXTURE3);
+    waitForVertexOffsets();
+    bindVertexOffsets(_computeSynth->shader(), GL_TEXTURE4);
+
+    // tiles are copied into a single RGBA image, bottom row first as in OpenGL
+    cv::Mat img(height, width, CV_8UC4);
+    glm::vec2 uvPerPixel(1.0f / _exemplarWidth, 1.0f / _exemplarHeight);
+    auto stats = _computeSynth->synthesize(width, height, glm::dvec2(0.0), uvPerPixel,
+        [&](int x, int y, int w, int h, const unsigned char* rgba) {
+            for(int row = 0; row < h; row++)
+                memcpy(img.ptr(y + row) + x * 4, rgba + row * w * 4, w * 4);
+        });
+
+    std::cout << "Baked " << width << " x " << height << " in " << stats.totalMilliseconds << " ms ("
+              << stats.gpuMilliseconds << " ms GPU, " << stats.megaPixelsPerSecond << " Mpix/s)" << std::endl;
+
+    cv::flip(img, img, 0);
+    cv::Mat bgr;
+    cv::cvtColor(img, bgr, cv::COLOR_RGBA2BGR);
+    return cv::imwrite(filename, bgr);
+}
+
+bool NoiseSynth::bakeVolumeCompute(int size, const std::string& filename)
+{
+    if(!_computeVolumeSynth)
+    {
+        std::cerr << "Compute synthesis is not supported by this context" << std::endl;
+        return false;
+    }
+    if(!waitForExemplar())
+        return false;
+
+    glActiveTexture(GL_TEXTURE0);
+    _noiseTexture->bind();
+    glActiveTexture(GL_TEXTURE1);
+    _gaussianTexture->bind();
+    glActiveTexture(GL_TEXTURE2);
+    _invLutTexture->bind();
+
+    _computeVolumeSynth->shader().use();
+    _computeVolumeSynth->shader().setInt("blendMode", blendMode);
+    _computeVolumeSynth->shader().setUint("hashSeed", (unsigned int)hashSeed);
+
+    // one exemplar texel per voxel, the lod of the footprint like ComputeLOD on the CPU side
+    float uvPerVoxel = 1.0f / _exemplarWidth;
+    float footprint = std::max(uvPerVoxel * _exemplarWidth, uvPerVoxel * _exemplarHeight);
+    _computeVolumeSynth->shader().setFloat("lod", std::max(0.0f, std::log2(footprint)));
+
+    try
+    {
+        VolumeBrickWriter writer(filename, size, size, size, 64);
+        auto stats = _computeVolumeSynth->synthesize(size, size, size, uvPerVoxel,
+            [&](glm::ivec3 brick, const unsigned char* rgba) { writer.writeBrick(brick, rgba); });
+        writer.finish();
+
+        std::cout << "Baked " << size << "^3 in " << stats.totalMilliseconds << " ms ("
+                  << stats.gpuMilliseconds << " ms GPU, " << stats.megaPixelsPerSecond << " Mvox/s)" << std::endl;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool NoiseSynth::bakeLibrary(int cellSize, const std::string& directory)
+{
+    if(!loadLibrary())
+        return false;
+
+    int columns = (int)std::ceil(std::sqrt((float)_library->size()));
+    int rows = (_library->size() + columns - 1) / columns;
+    int width = columns * cellSize;
+    int height = rows * cellSize;
+
+    // offscreen atlas receiving the single instanced draw
+    GLuint fbo = 0, atlas = 0;
+    glGenTextures(1, &atlas);
+    glBindTexture(GL_TEXTURE_2D, atlas);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlas, 0);
+
+    bool success = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if(success)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        glClear(GL_COLOR_BUFFER_BIT);
+        glDisable(GL_DEPTH_TEST);
+        draw_library_pass(width, height);
+
+        cv::Mat img(height, width, CV_8UC4);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, img.data);
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "Baked " << _library->size() << " exemplars in "
+                  << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+
+        // split the atlas, cell (0,0) is the bottom left one in OpenGL
+        cv::flip(img, img, 0);
+        for(int i = 0; i < _library->size(); i++)
+        {
+            int column = i % columns;
+            int row = rows - 1 - i / columns;
+            cv::Mat bgr;
+            cv::cvtColor(img(cv::Rect(column * cellSize, row * cellSize, cellSize, cellSize)), bgr, cv::COLOR_RGBA2BGR);
+            success &= cv::imwrite(directory + _library->name(i) + "_synth.png", bgr);
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &atlas);
+    glViewport(0, 0, _windowWidth, _windowHeight);
+    return success;
+}
+
+int NoiseSynth::checkGolden(const std::string& directory, bool update)
+{
+    if(!update && !std::filesystem::is_directory(directory))
+    {
+        std::cerr << "No golden references in " << directory << ", write them with update_golden.sh <known-good revision>" << std::endl;
+        return 1;
+    }
+    if(!waitForExemplar())
+        return 1;
+
+    // minified, one texel per pixel, several cells wide, magnified (256^2 exemplar)
+    const glm::ivec2 viewports[] = {{128, 128}, {256, 256}, {768, 256}, {512, 512}};
+    const int blendModes = 8;
+
+    SynthOptions options;
+    options.seamAware = seamAware;
+    auto exemplar = IsExemplarFile(_noisePath) ? LoadSynthExemplar(_noisePath, options) : LoadSynthExemplar(_noisePath, _gaussianPath, options);
+    ThreadPool pool;
+    exemplar->lut3D = std::make_shared<InverseLUT3D>(
+        BuildInverseLUT3D(exemplar->source[0], exemplar->gaussian[0], lut3DSize, pool));
+    exemplar->pyramid = std::make_shared<const ExemplarPyramid>(exemplar->source[0]);
+
+    int savedBlendMode = blendMode, savedHashSeed = hashSeed;
+    bool savedAnimate = animate;
+    hashSeed = 0;
+    animate = false;
+    exemplar->vertexOffsets = waitForVertexOffsets();
+    if(update)
+        std::filesystem::create_directories(directory);
+
+    int failures = 0;
+    for(glm::ivec2 viewport : viewports)
+    {
+        int width = viewport.x, height = viewport.y;
+        GLuint fbo = 0, target = 0;
+        glGenTextures(1, &target);
+        glBindTexture(GL_TEXTURE_2D, target);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+        glDisable(GL_DEPTH_TEST);
+
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        if(!complete)
+        {
+            std::cerr << "Couldn't create a " << width << " x " << height << " framebuffer" << std::endl;
+            failures++;
+        }
+        for(int mode = 0; complete && mode < blendModes; mode++)
+        {
+            blendMode = mode;
+            // the 3D LUT is built in the background, a failed build renders mode 2 and fails below
+            if(mode == 6)
+                while(!updateLUT3D() && _pendingLUT3D.valid())
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            // so are the pyramid bands, down to the first one the viewport shows
+            if(mode == 7)
+            {
+                float lod = std::log2((float)std::max(_exemplarWidth, _exemplarHeight) / (float)height);
+                int firstBand = FirstVisibleBand(lod, exemplar->pyramid->size());
+                while(updatePyramid(firstBand) != firstBand && _pendingPyramid.valid())
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            std::vector<unsigned char> gpu((size_t)width * height * 4), cpu(gpu.size());
+            glClear(GL_COLOR_BUFFER_BIT);
+            draw_blend_pass(width, height);
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, gpu.data());
+
+            // synth.fs maps the viewport height to one exemplar, pixel centers at (x + 0.5) / height
+            SynthesizeTile(*exemplar, glm::dvec2(0.0), glm::vec2(1.0f / height), width, height, mode, 0, cpu.data());
+
+            char name[64];
+            snprintf(name, sizeof(name), "mode%d_%dx%d.png", mode, width, height);
+            std::string gpuPath = (std::filesystem::path(directory) / ("gpu_" + std::string(name))).string();
+            std::string cpuPath = (std::filesystem::path(directory) / ("cpu_" + std::string(name))).string();
+
+            auto report = [&](const char* what, const ImageDifference& d, const GoldenThresholds& thresholds) {
+                bool pass = WithinThresholds(d, thresholds);
+                failures += !pass;
+                std::cout << (pass ? "  ok   " : "  FAIL ") << name << " " << what
+                          << " mean " << 255.0f * glm::max(d.meanError.r, glm::max(d.meanError.g, d.meanError.b))
+                          << " outliers " << 100.0f * glm::max(d.outliers.r, glm::max(d.outliers.g, d.outliers.b)) << "%"
+                          << " histogram " << 255.0f * glm::max(d.histogramDistance.r, glm::max(d.histogramDistance.g, d.histogramDistance.b))
+                          << std::endl;
+            };
+            auto missing = [&](const std::string& path) {
+                std::cout << "  FAIL " << name << " no reference at " << path << std::endl;
+                failures++;
+            };
+
+            report("gpu vs cpu", CompareImages(gpu.data(), cpu.data(), width, height, goldenCrossRenderer.outlierError), goldenCrossRenderer);
+            if(update)
+            {
+                WriteGoldenImage(gpuPath, width, height, gpu.data());
+                WriteGoldenImage(cpuPath, width, height, cpu.data());
+                continue;
+            }
+
+            std::vector<unsigned char> reference;
+            if(!ReadGoldenImage(gpuPath, width, height, reference))
+                missing(gpuPath);
+            else
+                report("gpu vs golden", CompareImages(gpu.data(), reference.data(), width, height, goldenSameRenderer.outlierError), goldenSameRenderer);
+            if(!ReadGoldenImage(cpuPath, width, height, reference))
+                missing(cpuPath);
+            else
+                report("cpu vs golden", CompareImages(cpu.data(), reference.data(), width, height, goldenSameRenderer.outlierError), goldenSameRenderer);
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteTextures(1, &target);
+    }
+
+    blendMode = savedBlendMode;
+    hashSeed = savedHashSeed;
+    animate = savedAnimate;
+    glViewport(0, 0, _windowWidth, _windowHeight);
+    std::cout << (update ? "Golden images written to " + directory : std::to_string(failures) + " failed comparisons") << std::endl;
+    return failures;
+}
@@ -0,0 +1,208 @@
+#include "ComputeSynth.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include "SynthGrid.hpp"
+#include "ExemplarPyramid.hpp"
+
+// work group sizes declared in synth.comp and synth3d.comp
+static const int kGroupSize = 16;
+static const int kVolumeGroupSize = 8;
+
+ComputeSynth::ComputeSynth(const std::string& computeShaderPath, int tileSize)
+	: _tileSize(tileSize)
+{
+	if (!isSupported())
+		throw std::runtime_error("compute synthesis requires an OpenGL 4.3 context");
+
+	_shader.reset(new Shader(computeShaderPath));
+	_shader->use();
+	_shader->setInt("src_texture", 0);
+	_shader->setInt("gauss_texture", 1);
+	_shader->setInt("inv_lut_texture", 2);
+	_shader->setInt("seam_offset_texture", 3);
+	_shader->setInt("vertex_offset_texture", 4);
+	_shader->setInt("inv_lut3d_texture", 5);
+	_shader->setInt("band_gauss_texture", 6);
+	_shader->setInt("band_lut_texture", 7);
+
+	// immutable storage for the tile the dispatches write into
+	glGenTextures(1, &_tileTexture);
+	glBindTexture(GL_TEXTURE_2D, _tileTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, _tileSize, _tileSize);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenQueries(1, &_timerQuery);
+}
+
+ComputeSynth::~ComputeSynth()
+{
+	if (_timerQuery != 0)
+		glDeleteQueries(1, &_timerQuery);
+	if (_tileTexture != 0)
+		glDeleteTextures(1, &_tileTexture);
+}
+
+bool ComputeSynth::isSupported()
+{
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	return major > 4 || (major == 4 && minor >= 3);
+}
+
+ComputeSynth::Stats ComputeSynth::synthesize(int width, int height, glm::dvec2 uvOrigin, glm::vec2 uvPerPixel, const TileCallback& onTile)
+{
+	Stats stats;
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::vector<unsigned char> pixels(_tileSize * _tileSize * 4);
+
+	_shader->use();
+	_shader->setVec2("uvPerPixel", uvPerPixel);
+	glBindImageTexture(0, _tileTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+	for (int y = 0; y < height; y += _tileSize)
+	for (int x = 0; x < width; x += _tileSize)
+	{
+		int w = std::min(_tileSize, width - x);
+		int h = std::min(_tileSize, height - y);
+
+		// integer part of the tile corner goes to the grid origin, the shader only sees the rest
+		glm::dvec2 tileUV = uvOrigin + glm::dvec2(x, y) * glm::dvec2(uvPerPixel);
+		glm::ivec2 cell((int)std::floor(tileUV.x), (int)std::floor(tileUV.y));
+		GridOrigin gridOrigin = ComputeGridOrigin(cell);
+		_shader->setVec2("uvOrigin", glm::vec2((float)(tileUV.x - cell.x), (float)(tileUV.y - cell.y)));
+		glUniform2i(glGetUniformLocation(_shader->getID(), "gridOriginVertex"), gridOrigin.vertex.x, gridOrigin.vertex.y);
+		_shader->setVec2("gridOriginFraction", gridOrigin.fraction);
+		// and the coarser grids of the pyramid bands, as SynthesizeMultiScale computes them
+		for (int k = 0; k < MAX_PYRAMID_BANDS; k++)
+		{
+			GridOrigin bandOrigin = ComputeGridOrigin(cell, 1.0 / (double)(1 << k));
+			std::string index = "[" + std::to_string(k) + "]";
+			glUniform2i(glGetUniformLocation(_shader->getID(), ("bandOriginVertex" + index).c_str()), bandOrigin.vertex.x, bandOrigin.vertex.y);
+			_shader->setVec2("bandOriginFraction" + index, bandOrigin.fraction);
+		}
+
+		glBeginQuery(GL_TIME_ELAPSED, _timerQuery);
+		glDispatchCompute((w + kGroupSize - 1) / kGroupSize, (h + kGroupSize - 1) / kGroupSize, 1);
+		glEndQuery(GL_TIME_ELAPSED);
+
+		// make the image writes visible to the read back
+		glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(_timerQuery, GL_QUERY_RESULT, &elapsed);
+		stats.gpuMilliseconds += elapsed * 1e-6;
+
+		// read back the whole tile and hand over only the valid w x h part
+		glBindTexture(GL_TEXTURE_2D, _tileTexture);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		if (w != _tileSize)
+		{
+			for (int row = 1; row < h; row++)
+				std::copy_n(&pixels[row * _tileSize * 4], w * 4, &pixels[row * w * 4]);
+		}
+
+		onTile(x, y, w, h, pixels.data());
+	}
+
+	glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+	auto end = std::chrono::high_resolution_clock::now();
+	stats.totalMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+	if (stats.gpuMilliseconds > 0.0)
+		stats.megaPixelsPerSecond = (double)width * height / (stats.gpuMilliseconds * 1e3);
+
+	return stats;
+}
+
+ComputeVolumeSynth::ComputeVolumeSynth(const std::string& computeShaderPath, int brickSize)
+	: _brickSize(brickSize)
+{
+	if (!ComputeSynth::isSupported())
+		throw std::runtime_error("compute synthesis requires an OpenGL 4.3 context");
+
+	_shader.reset(new Shader(computeShaderPath));
+	_shader->use();
+	_shader->setInt("src_texture", 0);
+	_shader->setInt("gauss_texture", 1);
+	_shader->setInt("inv_lut_texture", 2);
+
+	glGenTextures(1, &_brickTexture);
+	glBindTexture(GL_TEXTURE_3D, _brickTexture);
+	glTexStorage3D(GL_TEXTURE_3D, 1, GL_RGBA8, _brickSize, _brickSize, _brickSize);
+	glBindTexture(GL_TEXTURE_3D, 0);
+
+	glGenQueries(1, &_timerQuery);
+}
+
+ComputeVolumeSynth::~ComputeVolumeSynth()
+{
+	if (_timerQuery != 0)
+		glDeleteQueries(1, &_timerQuery);
+	if (_brickTexture != 0)
+		glDeleteTextures(1, &_brickTexture);
+}
+
+ComputeSynth::Stats ComputeVolumeSynth::synthesize(int width, int height, int depth, float uvPerVoxel, const BrickCallback& onBrick)
+{
+	ComputeSynth::Stats stats;
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::vector<unsigned char> voxels((size_t)_brickSize * _brickSize * _brickSize * 4);
+	int groups = (_brickSize + kVolumeGroupSize - 1) / kVolumeGroupSize;
+
+	_shader->use();
+	_shader->setFloat("uvPerVoxel", uvPerVoxel);
+	glBindImageTexture(0, _brickTexture, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+	for (int z = 0; z < depth; z += _brickSize)
+	for (int y = 0; y < height; y += _brickSize)
+	for (int x = 0; x < width; x += _brickSize)
+	{
+		// voxels past the volume end up in the zero padding of edge bricks
+		_shader->setVec3("uvOrigin", glm::vec3((float)x, (float)y, (float)z) * uvPerVoxel);
+
+		glBeginQuery(GL_TIME_ELAPSED, _timerQuery);
+		glDispatchCompute(groups, groups, groups);
+		glEndQuery(GL_TIME_ELAPSED);
+		glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(_timerQuery, GL_QUERY_RESULT, &elapsed);
+		stats.gpuMilliseconds += elapsed * 1e-6;
+
+		glBindTexture(GL_TEXTURE_3D, _brickTexture);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glGetTexImage(GL_TEXTURE_3D, 0, GL_RGBA, GL_UNSIGNED_BYTE, voxels.data());
+		glBindTexture(GL_TEXTURE_3D, 0);
+
+		int w = std::min(_brickSize, width - x), h = std::min(_brickSize, height - y), d = std::min(_brickSize, depth - z);
+		for (int k = 0; k < _brickSize; k++)
+		for (int j = 0; j < _brickSize; j++)
+		{
+			unsigned char* row = &voxels[(((size_t)k * _brickSize + j) * _brickSize) * 4];
+			if (k >= d || j >= h)
+				std::fill_n(row, _brickSize * 4, 0);
+			else if (w < _brickSize)
+				std::fill_n(row + w * 4, (_brickSize - w) * 4, 0);
+		}
+
+		onBrick(glm::ivec3(x, y, z) / _brickSize, voxels.data());
+	}
+
+	glBindImageTexture(0, 0, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+	auto end = std::chrono::high_resolution_clock::now();
+	stats.totalMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+	if (stats.gpuMilliseconds > 0.0)
+		stats.megaPixelsPerSecond = (double)width * height * depth / (stats.gpuMilliseconds * 1e3);
+
+	return stats;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "../base/shader.h"
+
+// GL 4.3 compute path of the synthesis: evaluates synth.comp into an image2D
+// tile by tile, so the output size is not bounded by the window or by
+// GL_MAX_TEXTURE_SIZE. Textures are expected on units 0 (source),
+// 1 (gaussian) and 2 (inverse LUT), same as the fragment path.
+class ComputeSynth
+{
+public:
+	// called once per finished tile, rgba holds w*h RGBA8 pixels, bottom row first
+	using TileCallback = std::function<void(int x, int y, int w, int h, const unsigned char* rgba)>;
+
+	struct Stats
+	{
+		double gpuMilliseconds = 0.0;
+		double totalMilliseconds = 0.0;
+		double megaPixelsPerSecond = 0.0;
+	};
+
+	ComputeSynth(const std::string& computeShaderPath, int tileSize = 2048);
+
+	~ComputeSynth();
+
+	// compute shaders and image load/store require a 4.3 context
+	static bool isSupported();
+
+	Shader& shader() { return *_shader; }
+
+	// synthesize width x height pixels, pixel (0,0) starting at uvOrigin; each tile
+	// gets its own integer grid origin, so uvOrigin can be arbitrarily far out
+	Stats synthesize(int width, int height, glm::dvec2 uvOrigin, glm::vec2 uvPerPixel, const TileCallback& onTile);
+
+private:
+	std::unique_ptr<Shader> _shader;
+	int _tileSize;
+	GLuint _tileTexture = 0;
+	GLuint _timerQuery = 0;
+};
+
+// Volume counterpart of ComputeSynth: evaluates synth3d.comp brick by brick into
+// an image3D, 2D exemplars only (see SynthesizeVoxel for 3D exemplars).
+class ComputeVolumeSynth
+{
+public:
+	// called once per finished brick, rgba holds brickSize^3 RGBA8 voxels, x fastest
+	using BrickCallback = std::function<void(glm::ivec3 brick, const unsigned char* rgba)>;
+
+	ComputeVolumeSynth(const std::string& computeShaderPath, int brickSize = 64);
+
+	~ComputeVolumeSynth();
+
+	Shader& shader() { return *_shader; }
+
+	// bricks of a width x height x depth volume, voxel (0,0,0) starting at the origin
+	ComputeSynth::Stats synthesize(int width, int height, int depth, float uvPerVoxel, const BrickCallback& onBrick);
+
+private:
+	std::unique_ptr<Shader> _shader;
+	int _brickSize;
+	GLuint _brickTexture = 0;
+	GLuint _timerQuery = 0;
+};
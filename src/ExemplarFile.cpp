@@ -0,0 +1,158 @@
+#include "ExemplarFile.hpp"
+#include "LUTParameters.hpp"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+	const uint64_t sectionAlignment = 4096;
+
+	uint64_t alignSection(uint64_t offset)
+	{
+		return (offset + sectionAlignment - 1) & ~(sectionAlignment - 1);
+	}
+
+	// top row first image to the stored layout
+	std::vector<unsigned char> encodeImage(const TextureDataFloat& image, ExemplarFileFormat format)
+	{
+		size_t pitch = (size_t)image.width * 3;
+		size_t componentSize = format == ExemplarFileUnorm16 ? sizeof(uint16_t) : sizeof(float);
+		std::vector<unsigned char> bytes(pitch * image.height * componentSize);
+		for (int y = 0; y < image.height; y++)
+		{
+			const float* in = image.Pixels() + (size_t)(image.height - 1 - y) * pitch;
+			unsigned char* out = bytes.data() + (size_t)y * pitch * componentSize;
+			if (format == ExemplarFileFloat32)
+			{
+				std::memcpy(out, in, pitch * sizeof(float));
+				continue;
+			}
+			for (size_t i = 0; i < pitch; i++)
+			{
+				uint16_t value = (uint16_t)std::lround(std::max(0.0f, std::min(1.0f, in[i])) * 65535.0f);
+				std::memcpy(out + i * sizeof(uint16_t), &value, sizeof(uint16_t));
+			}
+		}
+		return bytes;
+	}
+
+	TextureDataFloat decodeImage(const std::shared_ptr<const MappedFile>& file, const ExemplarFileHeader& header,
+		uint64_t offset)
+	{
+		if (header.format == ExemplarFileFloat32)
+		{
+			const float* pixels = reinterpret_cast<const float*>(file->data() + offset);
+			return TextureDataFloat::View(header.width, header.height, 3, pixels, file);
+		}
+
+		TextureDataFloat image(header.width, header.height, 3);
+		const uint16_t* pixels = reinterpret_cast<const uint16_t*>(file->data() + offset);
+		for (size_t i = 0; i < image.data.size(); i++)
+			image.data[i] = pixels[i] / 65535.0f;
+		return image;
+	}
+
+	void storeVec3(float out[4], glm::vec3 v)
+	{
+		out[0] = v.x;
+		out[1] = v.y;
+		out[2] = v.z;
+		out[3] = 0.0f;
+	}
+}
+
+bool IsExemplarFile(const std::string& path)
+{
+	return path.size() > 4 && path.compare(path.size() - 4, 4, ".nsx") == 0;
+}
+
+std::shared_ptr<const ExemplarFile> OpenExemplarFile(const std::string& path)
+{
+	auto exemplar = std::make_shared<ExemplarFile>();
+	exemplar->file = std::make_shared<const MappedFile>(path);
+	const MappedFile& file = *exemplar->file;
+
+	if (file.size() < sizeof(ExemplarFileHeader))
+		throw std::runtime_error(path + " is not an exemplar file");
+	ExemplarFileHeader& header = exemplar->header;
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (header.magic != EXEMPLAR_FILE_MAGIC || header.version != EXEMPLAR_FILE_VERSION)
+		throw std::runtime_error(path + " is not an exemplar file");
+	if (header.channels != 3 || header.format > ExemplarFileUnorm16 || header.width == 0 || header.height == 0 ||
+		header.lutWidth == 0 || header.lutHeight == 0)
+		throw std::runtime_error(path + ": unsupported exemplar layout");
+
+	size_t componentSize = header.format == ExemplarFileUnorm16 ? sizeof(uint16_t) : sizeof(float);
+	uint64_t imageBytes = (uint64_t)header.width * header.height * 3 * componentSize;
+	uint64_t lutBytes = (uint64_t)header.lutWidth * header.lutHeight * 3 * sizeof(float);
+	for (auto section : {std::make_pair(header.sourceOffset, imageBytes), std::make_pair(header.gaussianOffset, imageBytes),
+						 std::make_pair(header.lutOffset, lutBytes)})
+	{
+		if (section.first % sectionAlignment != 0 || section.first + section.second > file.size())
+			throw std::runtime_error(path + " is truncated");
+	}
+
+	exemplar->source = decodeImage(exemplar->file, header, header.sourceOffset);
+	exemplar->gaussian = decodeImage(exemplar->file, header, header.gaussianOffset);
+
+	ExemplarPrecompute& precompute = exemplar->precompute;
+	precompute.width = header.width;
+	precompute.height = header.height;
+	precompute.colorSpaceVec1 = glm::vec3(header.colorSpaceVec1[0], header.colorSpaceVec1[1], header.colorSpaceVec1[2]);
+	precompute.colorSpaceVec2 = glm::vec3(header.colorSpaceVec2[0], header.colorSpaceVec2[1], header.colorSpaceVec2[2]);
+	precompute.colorSpaceVec3 = glm::vec3(header.colorSpaceVec3[0], header.colorSpaceVec3[1], header.colorSpaceVec3[2]);
+	precompute.colorSpaceOrigin = glm::vec3(header.colorSpaceOrigin[0], header.colorSpaceOrigin[1], header.colorSpaceOrigin[2]);
+	precompute.Tinv = TextureDataFloat::View(header.lutWidth, header.lutHeight, 3,
+		reinterpret_cast<const float*>(file.data() + header.lutOffset), exemplar->file);
+	return exemplar;
+}
+
+void ConvertExemplar(const std::string& noisePath, const std::string& gaussianPath, const std::string& outputPath,
+	ExemplarFileFormat format)
+{
+	TextureDataFloat source, gaussian;
+	TextureDataFloat::FromDecodedImage(*DecodeImage(noisePath, 3), source);
+	TextureDataFloat::FromDecodedImage(*DecodeImage(gaussianPath, 3), gaussian);
+	if (source.width != gaussian.width || source.height != gaussian.height)
+		throw std::runtime_error(noisePath + " and " + gaussianPath + " differ in size");
+
+	ExemplarPrecompute precompute;
+	PrecomputeExemplar(noisePath, source, precompute);
+
+	std::vector<unsigned char> sourceBytes = encodeImage(source, format);
+	std::vector<unsigned char> gaussianBytes = encodeImage(gaussian, format);
+
+	ExemplarFileHeader header = {};
+	header.magic = EXEMPLAR_FILE_MAGIC;
+	header.version = EXEMPLAR_FILE_VERSION;
+	header.width = source.width;
+	header.height = source.height;
+	header.channels = 3;
+	header.format = format;
+	header.lutWidth = precompute.Tinv.width;
+	header.lutHeight = precompute.Tinv.height;
+	storeVec3(header.colorSpaceVec1, precompute.colorSpaceVec1);
+	storeVec3(header.colorSpaceVec2, precompute.colorSpaceVec2);
+	storeVec3(header.colorSpaceVec3, precompute.colorSpaceVec3);
+	storeVec3(header.colorSpaceOrigin, precompute.colorSpaceOrigin);
+	header.sourceOffset = alignSection(sizeof(header));
+	header.gaussianOffset = alignSection(header.sourceOffset + sourceBytes.size());
+	header.lutOffset = alignSection(header.gaussianOffset + gaussianBytes.size());
+
+	std::ofstream out(outputPath, std::ios::binary);
+	if (!out)
+		throw std::runtime_error("cannot open " + outputPath);
+	auto writeAt = [&out](uint64_t offset, const void* data, size_t size) {
+		out.seekp((std::streamoff)offset);
+		out.write(static_cast<const char*>(data), size);
+	};
+	writeAt(0, &header, sizeof(header));
+	writeAt(header.sourceOffset, sourceBytes.data(), sourceBytes.size());
+	writeAt(header.gaussianOffset, gaussianBytes.data(), gaussianBytes.size());
+	writeAt(header.lutOffset, precompute.Tinv.Pixels(), precompute.Tinv.data.size() * sizeof(float));
+	out.close();
+	if (!out)
+		throw std::runtime_error("failed to write " + outputPath);
+}
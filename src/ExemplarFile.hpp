@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "MappedFile.hpp"
+#include "Precompute.hpp"
+#include "TextureDataFloat.hpp"
+
+// .nsx: uncompressed exemplar with its precomputation, made to be mapped and
+// used in place. A header, then 4096-aligned sections: source and gaussian
+// images (width * height * 3, bottom row first, float32 or unorm16) and the
+// inverse LUT (lutWidth * lutHeight * 3 float32). Little endian.
+#define EXEMPLAR_FILE_MAGIC 0x3158534Eu // "NSX1"
+#define EXEMPLAR_FILE_VERSION 1u
+
+enum ExemplarFileFormat : uint32_t
+{
+	ExemplarFileFloat32 = 0,
+	ExemplarFileUnorm16 = 1,
+};
+
+struct ExemplarFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t channels;
+	uint32_t format;
+	uint32_t lutWidth;
+	uint32_t lutHeight;
+	float colorSpaceVec1[4];
+	float colorSpaceVec2[4];
+	float colorSpaceVec3[4];
+	float colorSpaceOrigin[4];
+	uint64_t sourceOffset;
+	uint64_t gaussianOffset;
+	uint64_t lutOffset;
+	uint64_t reserved;
+};
+
+struct ExemplarFile
+{
+	std::shared_ptr<const MappedFile> file;
+	ExemplarFileHeader header;
+
+	// views into the mapping for float32 files, converted for unorm16 ones
+	TextureDataFloat source;
+	TextureDataFloat gaussian;
+	ExemplarPrecompute precompute;
+
+	// sections as stored, for a direct upload with pixelType()
+	const void* sourcePixels() const { return file->data() + header.sourceOffset; }
+	const void* gaussianPixels() const { return file->data() + header.gaussianOffset; }
+	GLenum pixelType() const { return header.format == ExemplarFileUnorm16 ? GL_UNSIGNED_SHORT : GL_FLOAT; }
+};
+
+bool IsExemplarFile(const std::string& path);
+
+// maps path and checks its layout, throws on malformed files
+std::shared_ptr<const ExemplarFile> OpenExemplarFile(const std::string& path);
+
+// decodes and precomputes an exemplar once and writes it as .nsx
+void ConvertExemplar(const std::string& noisePath, const std::string& gaussianPath, const std::string& outputPath,
+	ExemplarFileFormat format = ExemplarFileFloat32);
@@ -0,0 +1,151 @@
+#include "ExemplarLibrary.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <glm/glm.hpp>
+#include "TextureDataFloat.hpp"
+#include "Precompute.hpp"
+
+// std140 layout of one entry of the ExemplarColorSpaces block
+struct ColorSpaceStd140
+{
+	glm::vec4 vec1;
+	glm::vec4 vec2;
+	glm::vec4 vec3;
+	glm::vec4 origin;
+};
+
+static GLuint CreateTextureArray(GLenum internalFormat, int width, int height, int layers, bool generateMips)
+{
+	GLuint handle = 0;
+	glGenTextures(1, &handle);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, handle);
+	if (HasImmutableTextureStorage())
+	{
+		int levels = generateMips ? 1 + (int)std::floor(std::log2((float)std::max(width, height))) : 1;
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, internalFormat, width, height, layers);
+	}
+	else
+	{
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, internalFormat, width, height, layers, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+	}
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, generateMips ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, generateMips ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, generateMips ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+	return handle;
+}
+
+// upload an 8 bit RGB image into one layer, bottom row first like Texture2D
+static void UploadLayer(GLuint array, const std::string& path, int layer, int width, int height)
+{
+	auto image = DecodeImage(path, 3);
+	if (image->width != width || image->height != height)
+		throw std::runtime_error(path + " does not match the size of the first exemplar of the library");
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int y = 0; y < height; y++)
+	{
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, y, layer, width, 1, 1, GL_RGB, GL_UNSIGNED_BYTE,
+			&image->pixels[(size_t)(height - 1 - y) * width * 3]);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+ExemplarLibrary::ExemplarLibrary(const std::vector<ExemplarPaths>& exemplars)
+{
+	if (exemplars.empty() || exemplars.size() > MAX_LIBRARY_EXEMPLARS)
+		throw std::runtime_error("exemplar library supports 1 to " + std::to_string(MAX_LIBRARY_EXEMPLARS) + " exemplars");
+
+	const int layers = (int)exemplars.size();
+	int lutWidth = 0;
+	std::vector<ColorSpaceStd140> colorSpaces(layers);
+
+	try
+	{
+		for (int layer = 0; layer < layers; layer++)
+		{
+			// CPU side precomputation, also gives the size of the arrays
+			TextureDataFloat input;
+			if (TextureDataFloat::LoadTextureFromPNG(exemplars[layer].source.c_str(), input))
+				throw std::runtime_error("load " + exemplars[layer].source + " failure");
+
+			// all layers share the LUT width chosen for the first exemplar, estimated rather than tuned
+			if (layer == 0)
+				lutWidth = ChooseLUTWidth(input);
+
+			ExemplarPrecompute precompute;
+			PrecomputeExemplar(input, precompute, lutWidth);
+			colorSpaces[layer] = {
+				glm::vec4(precompute.colorSpaceVec1, 0.0f),
+				glm::vec4(precompute.colorSpaceVec2, 0.0f),
+				glm::vec4(precompute.colorSpaceVec3, 0.0f),
+				glm::vec4(precompute.colorSpaceOrigin, 0.0f)};
+
+			if (layer == 0)
+			{
+				_width = input.width;
+				_height = input.height;
+				_sourceArray = CreateTextureArray(GL_RGB8, _width, _height, layers, true);
+				_gaussianArray = CreateTextureArray(GL_RGB8, _width, _height, layers, true);
+				_lutArray = CreateTextureArray(GL_RGB16F, lutWidth, 1, layers, false);
+			}
+
+			UploadLayer(_sourceArray, exemplars[layer].source, layer, _width, _height);
+			UploadLayer(_gaussianArray, exemplars[layer].gaussian, layer, _width, _height);
+
+			glBindTexture(GL_TEXTURE_2D_ARRAY, _lutArray);
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, lutWidth, 1, 1, GL_RGB, GL_FLOAT, precompute.Tinv.data.data());
+
+			std::string name = exemplars[layer].source.substr(exemplars[layer].source.find_last_of('/') + 1);
+			_names.push_back(name.substr(0, name.find_last_of('.')));
+		}
+	}
+	catch (const std::exception&)
+	{
+		cleanup();
+		throw;
+	}
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, _sourceArray);
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, _gaussianArray);
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	glGenBuffers(1, &_colorSpaceUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, _colorSpaceUBO);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(ColorSpaceStd140) * MAX_LIBRARY_EXEMPLARS, nullptr, GL_STATIC_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ColorSpaceStd140) * layers, colorSpaces.data());
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	std::cout << "Loaded exemplar library of " << layers << " exemplars" << std::endl;
+}
+
+ExemplarLibrary::~ExemplarLibrary()
+{
+	cleanup();
+}
+
+void ExemplarLibrary::bind(GLuint uniformBlockBinding) const
+{
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, _sourceArray);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, _gaussianArray);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, _lutArray);
+	glBindBufferBase(GL_UNIFORM_BUFFER, uniformBlockBinding, _colorSpaceUBO);
+}
+
+void ExemplarLibrary::cleanup()
+{
+	GLuint textures[] = {_sourceArray, _gaussianArray, _lutArray};
+	glDeleteTextures(3, textures);
+	_sourceArray = _gaussianArray = _lutArray = 0;
+	if (_colorSpaceUBO != 0)
+	{
+		glDeleteBuffers(1, &_colorSpaceUBO);
+		_colorSpaceUBO = 0;
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+// upper bound of the colour space UBO array in synth_array.fs
+#define MAX_LIBRARY_EXEMPLARS 64
+
+struct ExemplarPaths
+{
+	std::string source;
+	std::string gaussian;
+};
+
+// N exemplars of identical size packed into GL_TEXTURE_2D_ARRAYs (source,
+// gaussian, inverse LUT) with their colour space vectors in a UBO, so the
+// whole library is synthesized by one instanced draw of synth_array.fs.
+class ExemplarLibrary
+{
+public:
+	ExemplarLibrary(const std::vector<ExemplarPaths>& exemplars);
+
+	ExemplarLibrary(const ExemplarLibrary&) = delete;
+	ExemplarLibrary& operator=(const ExemplarLibrary&) = delete;
+
+	~ExemplarLibrary();
+
+	int size() const { return (int)_names.size(); }
+
+	// file name of layer i without directory and extension
+	const std::string& name(int i) const { return _names[i]; }
+
+	// binds source, gaussian and LUT arrays to units 0, 1, 2 and the colour space UBO
+	void bind(GLuint uniformBlockBinding) const;
+
+private:
+	std::vector<std::string> _names;
+	int _width = 0;
+	int _height = 0;
+
+	GLuint _sourceArray = 0;
+	GLuint _gaussianArray = 0;
+	GLuint _lutArray = 0;
+	GLuint _colorSpaceUBO = 0;
+
+	void cleanup();
+};
@@ -0,0 +1,84 @@
+#include "ExemplarPyramid.hpp"
+#include "SynthCPU.hpp"
+
+ExemplarPyramid::ExemplarPyramid(const TextureDataFloat& source, int bands)
+	: _levels(BuildMipChain(source))
+{
+	// the residual keeps at least 8 texels, coarser levels are too blurry to carry a histogram
+	int maxBands = std::max(1, (int)_levels.size() - 3);
+	bands = std::max(1, std::min(std::min(bands, maxBands), MAX_PYRAMID_BANDS));
+	_bands.resize(bands);
+	_once.reset(new std::once_flag[bands]);
+	// one width for the whole band array, estimated rather than tuned per band
+	_lutWidth = ChooseLUTWidth(source);
+
+	// variance of the source against the sum of the band variances
+	auto variance = [](const TextureDataFloat& image, glm::dvec3* mean) {
+		glm::dvec3 sum(0.0), sumSquares(0.0);
+		for (int y = 0; y < image.height; y++)
+		for (int x = 0; x < image.width; x++)
+		{
+			glm::dvec3 color(image.GetColorAt(x, y));
+			sum += color;
+			sumSquares += color * color;
+		}
+		double n = (double)image.width * image.height;
+		if (mean)
+			*mean = sum / n;
+		return sumSquares / n - (sum / n) * (sum / n);
+	};
+
+	glm::dvec3 mean;
+	glm::dvec3 sourceVariance = variance(source, &mean);
+	glm::dvec3 bandVariance(0.0);
+	for (int k = 0; k < bands; k++)
+		bandVariance += variance(bandImage(k), nullptr);
+	_mean = glm::vec3(mean);
+	for (int channel = 0; channel < 3; channel++)
+		_gain[channel] = bandVariance[channel] > 0.0 ? (float)std::sqrt(sourceVariance[channel] / bandVariance[channel]) : 1.0f;
+}
+
+TextureDataFloat ExemplarPyramid::bandImage(int k) const
+{
+	// Gaussian level k upsampled to the full resolution, texel centers on texel centers
+	auto upsample = [this](int level) {
+		const TextureDataFloat& coarse = _levels[level];
+		TextureDataFloat image(width(), height(), 3);
+		for (int y = 0; y < height(); y++)
+		for (int x = 0; x < width(); x++)
+			image.SetColorAt(x, y, SampleBilinearRepeat(coarse, glm::vec2((x + 0.5f) / width(), (y + 0.5f) / height())));
+		return image;
+	};
+
+	TextureDataFloat image = upsample(k);
+	if (k + 1 < size())
+	{
+		TextureDataFloat coarser = upsample(k + 1);
+		for (size_t i = 0; i < image.data.size(); i++)
+			image.data[i] -= coarser.data[i];
+	}
+	return image;
+}
+
+const ExemplarBand& ExemplarPyramid::band(int k) const
+{
+	std::call_once(_once[k], [this, k] {
+		TextureDataFloat image = bandImage(k);
+		auto band = std::make_unique<ExemplarBand>();
+		TextureDataFloat gaussian;
+		PrecomputeExemplar(image, band->precompute, _lutWidth, &gaussian);
+		band->gaussian = BuildMipChain(std::move(gaussian));
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		_bands[k] = std::move(band);
+	});
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	return *_bands[k];
+}
+
+bool ExemplarPyramid::built(int k) const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _bands[k] != nullptr;
+}
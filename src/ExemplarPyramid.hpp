@@ -0,0 +1,79 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Precompute.hpp"
+#include "TextureDataFloat.hpp"
+
+// upper bound of the band uniform arrays in synth.fs
+#define MAX_PYRAMID_BANDS 4
+
+// Multi-scale exemplar (blendMode 7): a Laplacian pyramid of the source with
+// every band kept at full resolution, so it tiles like the exemplar. Band k
+// holds the details between Gaussian levels k and k + 1, the last band the
+// low-pass residual, and the bands sum back to the source. Each band is
+// decorrelated, Gaussianized and inverted by its own LUT, on a triangle grid
+// 2^k times larger than the one of band 0. Neighbouring bands of the source
+// are correlated, independently synthesized ones are not, so the sum is
+// scaled back to the source contrast around its mean.
+
+struct ExemplarBand
+{
+	// Gaussianized band, bottom row first, and its mip chain
+	std::vector<TextureDataFloat> gaussian;
+	// colour space and inverse LUT back to band values
+	ExemplarPrecompute precompute;
+};
+
+class ExemplarPyramid
+{
+public:
+	// source bottom row first like SynthExemplar, bands is clamped to what its size allows
+	explicit ExemplarPyramid(const TextureDataFloat& source, int bands = MAX_PYRAMID_BANDS);
+
+	int size() const { return (int)_bands.size(); }
+
+	int width() const { return _levels[0].width; }
+
+	int height() const { return _levels[0].height; }
+
+	// shared by all bands, so they fit in one array texture
+	int lutWidth() const { return _lutWidth; }
+
+	// per RGB channel, the sum of the bands maps to mean + gain * (sum - mean)
+	glm::vec3 mean() const { return _mean; }
+
+	glm::vec3 gain() const { return _gain; }
+
+	// band k, built by its first caller, bands nobody asks for are never built
+	const ExemplarBand& band(int k) const;
+
+	// band k before its precomputation
+	TextureDataFloat bandImage(int k) const;
+
+	bool built(int k) const;
+
+private:
+	std::vector<TextureDataFloat> _levels;
+	int _lutWidth = 0;
+	glm::vec3 _mean = glm::vec3(0.0f);
+	glm::vec3 _gain = glm::vec3(1.0f);
+	mutable std::vector<std::unique_ptr<ExemplarBand>> _bands;
+	mutable std::unique_ptr<std::once_flag[]> _once;
+	mutable std::mutex _mutex;
+};
+
+// bands finer than a pixel footprint of 2^lod texels average out, the first one that does not
+inline int FirstVisibleBand(float lod, int bands)
+{
+	return std::max(0, std::min((int)std::floor(lod), bands - 1));
+}
+
+// seed of the offsets of band k, band 0 draws the offsets of the single-scale blend
+inline uint32_t BandSeed(uint32_t seed, int k)
+{
+	return seed + (uint32_t)k * 0x632BE5ABu;
+}
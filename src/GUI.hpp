@@ -17,6 +17,8 @@ void NoiseSynth::drawLightGUI()
     }
     else
     {
+        if(!_exemplarReady)
+            ImGui::Text("Loading exemplar...");
         ImGui::Text("Synth Type");
         ImGui::RadioButton("Linear Mapping", &blendMode, 0);
         ImGui::SameLine();
@@ -29,12 +31,64 @@ void NoiseSynth::drawLightGUI()
         ImGui::RadioButton("Gaussian Texture", &blendMode, 4);
         ImGui::SameLine();
         ImGui::RadioButton("Gaussian Bleded", &blendMode, 5);
-        ImGui::End();
+        ImGui::RadioButton("3D LUT Mapping", &blendMode, 6);
+        ImGui::SameLine();
+        ImGui::SliderInt("3D LUT Size", &lut3DSize, 8, 64);
+        ImGui::RadioButton("Multi-scale Mapping", &blendMode, 7);
+        ImGui::InputInt("Hash Seed", &hashSeed);
+        ImGui::Checkbox("Seam-aware Offsets", &seamAware);
+        ImGui::Checkbox("Precomputed Offsets", &offsetTable);
+        if(offsetTable)
+        {
+            ImGui::SliderInt("Offset Table Size (log2)", &offsetTableLog2, 4, 10);
+            ImGui::SliderFloat("Rotation Jitter", &offsetRotation, 0.0f, 3.14159265f);
+            ImGui::SliderFloat("Scale Jitter", &offsetScale, 0.0f, 0.5f);
+        }
+        if((seamAware || offsetTable) && (animate || blendMode == 7))
+            ImGui::Text("Animate and Multi-scale Mapping use the plain hash");
+
+        ImGui::Checkbox("Mesh Preview", &showMesh);
+        ImGui::InputText("Mesh Path", meshPathBuffer, sizeof(meshPathBuffer));
+        if(showMesh)
+        {
+            ImGui::SliderFloat("Noise Scale", &meshNoiseScale, 0.01f, 100.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+            ImGui::SliderFloat("Triplanar Sharpness", &triplanarSharpness, 1.0f, 16.0f);
+            ImGui::Text("Right drag to orbit, wheel to zoom");
+        }
+        ImGui::Checkbox("Animate", &animate);
+        ImGui::SameLine();
+        ImGui::SliderFloat("Speed", &animationSpeed, 0.0f, 2.0f);
 
         ImGui::Separator();
         ImGui::Text("File name  (Press TAB to save, no extension required.)");
         ImGui::InputText("Screenshot Path",input_buffer, sizeof(input_buffer));
 
+        ImGui::Separator();
+        ImGui::Text("Exemplar (reloaded in the background)");
+        ImGui::InputText("Source Path", noisePathBuffer, sizeof(noisePathBuffer));
+        ImGui::InputText("Gaussian Path", gaussianPathBuffer, sizeof(gaussianPathBuffer));
+        if(ImGui::Button("Reload"))
+            requestExemplar(noisePathBuffer, gaussianPathBuffer);
+        ImGui::SameLine();
+        ImGui::Checkbox("Watch Files", &watchExemplar);
+        if(_pendingExemplar && _exemplarReady)
+            ImGui::Text("Reloading...");
+
+        ImGui::Separator();
+        ImGui::Checkbox("Exemplar Library", &showLibrary);
+        ImGui::SameLine();
+        if(ImGui::Button("Bake Library") && loadLibrary())
+            bakeLibrary(1024, "../result/");
+
+        if(_computeSynth)
+        {
+            ImGui::Separator();
+            ImGui::Text("Compute Bake (one exemplar texel per pixel)");
+            ImGui::InputInt2("Bake Size", bakeSize);
+            if(ImGui::Button("Bake"))
+                bakeCompute(bakeSize[0], bakeSize[1], std::string("../result/") + input_buffer + "_bake.png");
+        }
+        ImGui::End();
     }
 
     ImGui::Render();
@@ -0,0 +1,70 @@
+#include "GoldenImage.hpp"
+#include "QualityMetrics.hpp"
+#include <cmath>
+#include <stdexcept>
+#include <opencv2/opencv.hpp>
+
+ImageDifference CompareImages(const unsigned char* a, const unsigned char* b, int width, int height, float outlierError)
+{
+	ImageDifference difference;
+	size_t pixels = (size_t)width * height;
+	if (pixels == 0)
+		return difference;
+
+	int outlierLevel = (int)std::ceil(outlierError * 255.0f);
+	for (int channel = 0; channel < 3; channel++)
+	{
+		std::array<uint64_t, 256> histogramA{}, histogramB{};
+		double errorSum = 0.0;
+		size_t outliers = 0;
+		for (size_t i = 0; i < pixels; i++)
+		{
+			int va = a[i * 4 + channel], vb = b[i * 4 + channel];
+			int error = std::abs(va - vb);
+			errorSum += error;
+			outliers += error > outlierLevel;
+			histogramA[va]++;
+			histogramB[vb]++;
+		}
+
+		difference.meanError[channel] = (float)(errorSum / (pixels * 255.0));
+		difference.outliers[channel] = (float)((double)outliers / pixels);
+		difference.histogramDistance[channel] = WassersteinDistance(histogramA, histogramB);
+	}
+	return difference;
+}
+
+bool WithinThresholds(const ImageDifference& difference, const GoldenThresholds& thresholds)
+{
+	for (int channel = 0; channel < 3; channel++)
+	{
+		if (difference.meanError[channel] > thresholds.meanError ||
+			difference.outliers[channel] > thresholds.outlierFraction ||
+			difference.histogramDistance[channel] > thresholds.histogramDistance)
+			return false;
+	}
+	return true;
+}
+
+bool ReadGoldenImage(const std::string& filename, int width, int height, std::vector<unsigned char>& rgba)
+{
+	cv::Mat bgr = cv::imread(filename, cv::IMREAD_COLOR);
+	if (bgr.empty() || bgr.cols != width || bgr.rows != height)
+		return false;
+
+	cv::Mat img;
+	cv::cvtColor(bgr, img, cv::COLOR_BGR2RGBA);
+	cv::flip(img, img, 0);
+	rgba.assign(img.data, img.data + (size_t)width * height * 4);
+	return true;
+}
+
+void WriteGoldenImage(const std::string& filename, int width, int height, const unsigned char* rgba)
+{
+	cv::Mat img(height, width, CV_8UC4, const_cast<unsigned char*>(rgba));
+	cv::Mat bgr;
+	cv::flip(img, bgr, 0);
+	cv::cvtColor(bgr, bgr, cv::COLOR_RGBA2BGR);
+	if (!cv::imwrite(filename, bgr))
+		throw std::runtime_error("Couldn't write " + filename);
+}
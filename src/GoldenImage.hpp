@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Regression checks of synthesized images against stored references. The
+// images are RGBA8, bottom row first as glReadPixels and SynthesizeTile give
+// them; the references are PNGs so a failing one can be opened and compared.
+
+// per channel difference between two images, every value in [0, 1]
+struct ImageDifference
+{
+	// mean absolute error
+	glm::vec3 meanError = glm::vec3(0.0f);
+	// fraction of the pixels off by more than the outlier error
+	glm::vec3 outliers = glm::vec3(0.0f);
+	// 1D Wasserstein distance between the 256 bin histograms
+	glm::vec3 histogramDistance = glm::vec3(0.0f);
+};
+
+// a few pixels may flip to another triangle or LUT texel after a harmless
+// change, the statistics of the image should not move
+struct GoldenThresholds
+{
+	float meanError;
+	float outlierError;
+	float outlierFraction;
+	float histogramDistance;
+};
+
+// the same renderer against its own stored output
+const GoldenThresholds goldenSameRenderer = {0.5f / 255.0f, 8.0f / 255.0f, 0.002f, 0.5f / 255.0f};
+// synth.fs against the CPU reference, which filters the LUT and picks mip levels slightly differently
+const GoldenThresholds goldenCrossRenderer = {3.0f / 255.0f, 24.0f / 255.0f, 0.02f, 2.0f / 255.0f};
+
+ImageDifference CompareImages(const unsigned char* a, const unsigned char* b, int width, int height, float outlierError);
+
+bool WithinThresholds(const ImageDifference& difference, const GoldenThresholds& thresholds);
+
+// false if the file is missing or of another size
+bool ReadGoldenImage(const std::string& filename, int width, int height, std::vector<unsigned char>& rgba);
+
+void WriteGoldenImage(const std::string& filename, int width, int height, const unsigned char* rgba);
@@ -0,0 +1,125 @@
+#include "InverseLUT3D.hpp"
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <stdexcept>
+
+InverseLUT3D BuildInverseLUT3D(const TextureDataFloat& source, const TextureDataFloat& gaussian, int size,
+	ThreadPool& pool, int minSamples)
+{
+	if (source.width != gaussian.width || source.height != gaussian.height)
+		throw std::runtime_error("exemplar and gaussian must have the same size for a 3D LUT");
+	if (size < 2)
+		throw std::runtime_error("3D LUT size must be at least 2");
+
+	int pixels = source.width * source.height;
+	minSamples = std::min(minSamples, pixels);
+	auto cellOf = [size](float v) { return std::max(0, std::min(size - 1, (int)std::floor(v * size))); };
+
+	// bucket the pairs by gaussian cell (counting sort)
+	size_t cells = (size_t)size * size * size;
+	std::vector<glm::vec3> G(pixels), C(pixels);
+	std::vector<int> cellIndex(pixels);
+	std::vector<int> cellStart(cells + 1, 0);
+	for (int y = 0; y < source.height; y++)
+	for (int x = 0; x < source.width; x++)
+	{
+		int i = y * source.width + x;
+		G[i] = gaussian.GetColorAt(x, y);
+		C[i] = source.GetColorAt(x, y);
+		cellIndex[i] = (cellOf(G[i].b) * size + cellOf(G[i].g)) * size + cellOf(G[i].r);
+		cellStart[cellIndex[i] + 1]++;
+	}
+	for (size_t c = 0; c < cells; c++)
+		cellStart[c + 1] += cellStart[c];
+	std::vector<int> order(pixels);
+	std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+	for (int i = 0; i < pixels; i++)
+		order[fill[cellIndex[i]]++] = i;
+
+	// summed volume of the counts, any box count in O(1)
+	int n = size + 1;
+	std::vector<int> sum((size_t)n * n * n, 0);
+	auto S = [&sum, n](int r, int g, int b) -> int& { return sum[((size_t)b * n + g) * n + r]; };
+	for (int b = 1; b < n; b++)
+	for (int g = 1; g < n; g++)
+	for (int r = 1; r < n; r++)
+	{
+		size_t c = ((size_t)(b - 1) * size + g - 1) * size + r - 1;
+		S(r, g, b) = cellStart[c + 1] - cellStart[c] + S(r - 1, g, b) + S(r, g - 1, b) + S(r, g, b - 1)
+			- S(r - 1, g - 1, b) - S(r - 1, g, b - 1) - S(r, g - 1, b - 1) + S(r - 1, g - 1, b - 1);
+	}
+	auto boxCount = [&S](glm::ivec3 lo, glm::ivec3 hi) {
+		return S(hi.x, hi.y, hi.z) - S(lo.x, hi.y, hi.z) - S(hi.x, lo.y, hi.z) - S(hi.x, hi.y, lo.z)
+			+ S(lo.x, lo.y, hi.z) + S(lo.x, hi.y, lo.z) + S(hi.x, lo.y, lo.z) - S(lo.x, lo.y, lo.z);
+	};
+
+	InverseLUT3D lut;
+	lut.size = size;
+	lut.rgb.resize(cells * 3);
+
+	auto buildSlice = [&](int b) {
+		for (int g = 0; g < size; g++)
+		for (int r = 0; r < size; r++)
+		{
+			glm::ivec3 cell(r, g, b);
+			glm::vec3 center = (glm::vec3(cell) + glm::vec3(0.5f)) / (float)size;
+
+			// grow the box until it holds enough pairs, bounds are exclusive on the low side
+			int radius = 0;
+			glm::ivec3 lo, hi;
+			for (;; radius++)
+			{
+				lo = glm::max(cell - glm::ivec3(radius), glm::ivec3(0));
+				hi = glm::min(cell + glm::ivec3(radius + 1), glm::ivec3(size));
+				if (boxCount(lo, hi) >= minSamples || radius >= size)
+					break;
+			}
+
+			// kernel as wide as the box so the farthest pairs still count
+			float h = (radius + 0.5f) / size;
+			float invTwoH2 = 1.0f / (2.0f * h * h);
+			glm::vec3 color(0.0f);
+			float weights = 0.0f;
+			for (int k = lo.z; k < hi.z; k++)
+			for (int j = lo.y; j < hi.y; j++)
+			{
+				size_t row = ((size_t)k * size + j) * size;
+				for (int p = cellStart[row + lo.x]; p < cellStart[row + hi.x]; p++)
+				{
+					glm::vec3 d = G[order[p]] - center;
+					float w = std::exp(-glm::dot(d, d) * invTwoH2);
+					color = color + w * C[order[p]];
+					weights += w;
+				}
+			}
+
+			float* out = &lut.rgb[(((size_t)b * size + g) * size + r) * 3];
+			color = weights > 0.0f ? color / weights : center;
+			out[0] = color.r;
+			out[1] = color.g;
+			out[2] = color.b;
+		}
+	};
+
+	std::vector<std::future<void>> slices;
+	for (int b = 0; b < size; b++)
+		slices.push_back(pool.submit([&buildSlice, b] { buildSlice(b); }));
+	for (auto& slice : slices)
+		slice.get();
+
+	return lut;
+}
+
+glm::vec3 LookupLUT3D(const InverseLUT3D& lut, glm::vec3 G)
+{
+	glm::vec3 x = glm::clamp(G * (float)lut.size - glm::vec3(0.5f), 0.0f, (float)(lut.size - 1));
+	glm::ivec3 i0 = glm::ivec3(glm::floor(x));
+	glm::ivec3 i1 = glm::min(i0 + glm::ivec3(1), glm::ivec3(lut.size - 1));
+	glm::vec3 t = x - glm::vec3(i0);
+	glm::vec3 c00 = glm::mix(lut.at(i0.x, i0.y, i0.z), lut.at(i1.x, i0.y, i0.z), t.x);
+	glm::vec3 c10 = glm::mix(lut.at(i0.x, i1.y, i0.z), lut.at(i1.x, i1.y, i0.z), t.x);
+	glm::vec3 c01 = glm::mix(lut.at(i0.x, i0.y, i1.z), lut.at(i1.x, i0.y, i1.z), t.x);
+	glm::vec3 c11 = glm::mix(lut.at(i0.x, i1.y, i1.z), lut.at(i1.x, i1.y, i1.z), t.x);
+	return glm::mix(glm::mix(c00, c10, t.y), glm::mix(c01, c11, t.y), t.z);
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "TextureDataFloat.hpp"
+#include "../base/thread_pool.h"
+
+// Full RGB inverse transform, gaussian colour -> exemplar colour. The PCA and
+// per channel LUTs only undo the marginals; exemplars with strongly correlated
+// colours (fire) need the joint mapping. It is read off the transport that
+// gaussianize.py computed: pixel (x, y) of the gaussian image is the image of
+// pixel (x, y) of the exemplar.
+struct InverseLUT3D
+{
+	int size = 0;
+	// size^3 RGB colours in the original colour space, r fastest, cell centers at (i + 0.5) / size
+	std::vector<float> rgb;
+
+	glm::vec3 at(int r, int g, int b) const
+	{
+		const float* c = &rgb[(((size_t)b * size + g) * size + r) * 3];
+		return glm::vec3(c[0], c[1], c[2]);
+	}
+};
+
+// Every cell is a gaussian-weighted average of the exemplar colours whose
+// gaussian values are closest to its center: the search box grows one cell at a
+// time until it holds minSamples pairs, so empty cells in the tails still get
+// the nearest colours. Slices are built in parallel on pool.
+InverseLUT3D BuildInverseLUT3D(const TextureDataFloat& source, const TextureDataFloat& gaussian, int size,
+	ThreadPool& pool, int minSamples = 8);
+
+// trilinear lookup matching a GL_LINEAR, clamp to edge 3D texture
+glm::vec3 LookupLUT3D(const InverseLUT3D& lut, glm::vec3 G);
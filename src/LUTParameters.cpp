@@ -0,0 +1,110 @@
+#include "LUTParameters.hpp"
+#include <filesystem>
+#include <fstream>
+#include <limits>
+
+namespace
+{
+std::string ParametersPath(const std::string& exemplarPath)
+{
+	return exemplarPath + ".lutparams";
+}
+
+void SourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& time)
+{
+	size = (uint64_t)std::filesystem::file_size(sourcePath);
+	time = (int64_t)std::filesystem::last_write_time(sourcePath).time_since_epoch().count();
+}
+}
+
+bool ReadLUTParameters(const std::string& exemplarPath, LUTParameters& parameters)
+{
+	try
+	{
+		std::ifstream file(ParametersPath(exemplarPath));
+		if (!file)
+			return false;
+
+		uint64_t size = 0, storedSize = 0;
+		int64_t time = 0, storedTime = 0;
+		float targetError = -1.0f;
+		int tunerVersion = 0;
+		LUTParameters stored;
+		std::string key;
+		while (file >> key)
+		{
+			if (key == "sourceSize")
+				file >> storedSize;
+			else if (key == "sourceTime")
+				file >> storedTime;
+			else if (key == "targetError")
+				file >> targetError;
+			else if (key == "tunerVersion")
+				file >> tunerVersion;
+			else if (key == "width")
+				file >> stored.width;
+			else if (key == "filterSamples")
+				file >> stored.filterSamples;
+			else if (key == "error")
+				file >> stored.error;
+			else
+				file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+		}
+
+		SourceStamp(exemplarPath, size, time);
+		if (size != storedSize || time != storedTime || targetError != LUT_TARGET_ERROR || tunerVersion != LUT_TUNER_VERSION ||
+			stored.width < 1 || stored.width > LUT_MAX_WIDTH || stored.filterSamples < 1)
+			return false;
+		parameters = stored;
+		return true;
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+}
+
+void WriteLUTParameters(const std::string& exemplarPath, const LUTParameters& parameters)
+{
+	try
+	{
+		uint64_t size;
+		int64_t time;
+		SourceStamp(exemplarPath, size, time);
+
+		// written under a temporary name, a reader never sees a half written file
+		std::string path = ParametersPath(exemplarPath);
+		std::string temporary = path + ".tmp";
+		{
+			std::ofstream file(temporary);
+			file.precision(9);
+			file << "sourceSize " << size << "\n"
+				 << "sourceTime " << time << "\n"
+				 << "targetError " << LUT_TARGET_ERROR << "\n"
+				 << "tunerVersion " << LUT_TUNER_VERSION << "\n"
+				 << "width " << parameters.width << "\n"
+				 << "filterSamples " << parameters.filterSamples << "\n"
+				 << "error " << parameters.error << "\n";
+			if (!file)
+				return;
+		}
+		std::filesystem::rename(temporary, path);
+	}
+	catch (const std::exception&)
+	{
+	}
+}
+
+void PrecomputeExemplar(const std::string& exemplarPath, TextureDataFloat& input, ExemplarPrecompute& out)
+{
+	// one prefiltered LUT row per LOD, with the stored width and sample count
+	LUTParameters parameters;
+	if (ReadLUTParameters(exemplarPath, parameters))
+	{
+		PrecomputeExemplar(input, out, parameters, true);
+		return;
+	}
+
+	PrecomputeExemplar(input, out, LUTParameters(), true);
+	WriteLUTParameters(exemplarPath, out.lutParameters);
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+#include "Precompute.hpp"
+
+// Tuned LUT parameters kept next to the exemplar as <exemplar>.lutparams, a
+// "key value" text file that can be edited by hand. The parameters are tuned
+// again when the exemplar size or modification time, the target error or the
+// tuner version change.
+
+// 2: prefilter kernels measured on the gaussianized exemplar
+#define LUT_TUNER_VERSION 2
+
+// parameters stored for exemplarPath, false when there are none, they are stale
+// or the width is outside [1, LUT_MAX_WIDTH]
+bool ReadLUTParameters(const std::string& exemplarPath, LUTParameters& parameters);
+
+// failures are ignored, the exemplar may live in a read-only directory
+void WriteLUTParameters(const std::string& exemplarPath, const LUTParameters& parameters);
+
+// PrecomputeExemplar with the stored parameters, tuned and stored on first use
+void PrecomputeExemplar(const std::string& exemplarPath, TextureDataFloat& input, ExemplarPrecompute& out);
@@ -0,0 +1,84 @@
+#include "MappedFile.hpp"
+#include <stdexcept>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path) : _path(path)
+{
+	_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (_file == INVALID_HANDLE_VALUE)
+	{
+		_file = nullptr;
+		throw std::runtime_error("cannot open " + path);
+	}
+
+	LARGE_INTEGER size;
+	GetFileSizeEx(_file, &size);
+	_size = (size_t)size.QuadPart;
+	if (_size == 0)
+		return;
+
+	_mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (_mapping)
+		_data = static_cast<const unsigned char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!_data)
+	{
+		if (_mapping)
+			CloseHandle(_mapping);
+		CloseHandle(_file);
+		throw std::runtime_error("cannot map " + path);
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (_data)
+		UnmapViewOfFile(_data);
+	if (_mapping)
+		CloseHandle(_mapping);
+	if (_file)
+		CloseHandle(_file);
+}
+#else
+MappedFile::MappedFile(const std::string& path) : _path(path)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw std::runtime_error("cannot open " + path);
+
+	struct stat info;
+	if (fstat(fd, &info) != 0)
+	{
+		close(fd);
+		throw std::runtime_error("cannot stat " + path);
+	}
+	_size = (size_t)info.st_size;
+	if (_size == 0)
+	{
+		close(fd);
+		return;
+	}
+
+	// the mapping stays valid after closing the descriptor
+	void* mapped = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED)
+		throw std::runtime_error("cannot map " + path);
+	_data = static_cast<const unsigned char*>(mapped);
+}
+
+MappedFile::~MappedFile()
+{
+	if (_data)
+		munmap(const_cast<unsigned char*>(_data), _size);
+}
+#endif
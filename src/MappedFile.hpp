@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// Read only memory mapping of a whole file
+class MappedFile
+{
+public:
+	// throws if the file cannot be opened or mapped
+	explicit MappedFile(const std::string& path);
+
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const unsigned char* data() const { return _data; }
+
+	size_t size() const { return _size; }
+
+	const std::string& path() const { return _path; }
+
+private:
+	std::string _path;
+	const unsigned char* _data = nullptr;
+	size_t _size = 0;
+#ifdef _WIN32
+	void* _file = nullptr;
+	void* _mapping = nullptr;
+#endif
+};
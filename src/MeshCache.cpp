@@ -0,0 +1,174 @@
+#include "MeshCache.hpp"
+#include <iostream>
+#include "../base/model.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+std::string CachePath(const std::string& sourcePath)
+{
+	return sourcePath + ".meshcache";
+}
+
+void SourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& time)
+{
+	size = (uint64_t)std::filesystem::file_size(sourcePath);
+	time = (int64_t)std::filesystem::last_write_time(sourcePath).time_since_epoch().count();
+}
+
+// 32-bit words of the vertex, -0 folded onto 0 so the hash agrees with operator==
+inline uint32_t FloatBits(float value)
+{
+	uint32_t bits;
+	value = value == 0.0f ? 0.0f : value;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+inline uint64_t HashVertex(const Vertex& vertex)
+{
+	const float words[8] = {vertex.position.x, vertex.position.y, vertex.position.z, vertex.normal.x,
+							vertex.normal.y, vertex.normal.z, vertex.texCoord.x, vertex.texCoord.y};
+	uint64_t h = 0x9E3779B97F4A7C15ull;
+	for (float word : words)
+	{
+		h ^= FloatBits(word);
+		h *= 0xBF58476D1CE4E5B9ull;
+		h ^= h >> 31;
+	}
+	return h;
+}
+}
+
+void DeduplicateVertices(const a_attrib& attrib, const a_shape& shapes, MeshData& mesh)
+{
+	size_t corners = shapes._indices.size() * 3;
+	mesh.vertices.clear();
+	mesh.indices.clear();
+	mesh.indices.reserve(corners);
+
+	// power of two capacity, at most half full, slots hold vertex indices
+	size_t capacity = 16;
+	while (capacity < 2 * corners)
+		capacity *= 2;
+	const uint32_t empty = 0xFFFFFFFFu;
+	std::vector<uint32_t> table(capacity, empty);
+	size_t mask = capacity - 1;
+
+	for (const auto& face : shapes._indices)
+	{
+		for (const auto& index : face.mesh_vec)
+		{
+			Vertex vertex{};
+			vertex.position = attrib._vertices[index.vertex_index - 1];
+			// 0 means the face has no such attribute
+			if (index.uv_index > 0)
+				vertex.texCoord = attrib._uvs[index.uv_index - 1];
+			if (index.normal_index > 0)
+				vertex.normal = attrib._normals[index.normal_index - 1];
+
+			// linear probing, one hash per corner
+			size_t slot = HashVertex(vertex) & mask;
+			while (table[slot] != empty && !(mesh.vertices[table[slot]] == vertex))
+				slot = (slot + 1) & mask;
+			if (table[slot] == empty)
+			{
+				table[slot] = (uint32_t)mesh.vertices.size();
+				mesh.vertices.push_back(vertex);
+			}
+			mesh.indices.push_back(table[slot]);
+		}
+	}
+}
+
+std::unique_ptr<MeshCache> OpenMeshCache(const std::string& sourcePath)
+{
+	std::error_code error;
+	if (!std::filesystem::exists(CachePath(sourcePath), error))
+		return nullptr;
+
+	try
+	{
+		auto cache = std::make_unique<MeshCache>();
+		cache->file.reset(new MappedFile(CachePath(sourcePath)));
+		if (cache->file->size() < sizeof(MeshCacheHeader))
+			return nullptr;
+		memcpy(&cache->header, cache->file->data(), sizeof(MeshCacheHeader));
+
+		const MeshCacheHeader& header = cache->header;
+		uint64_t size;
+		int64_t time;
+		SourceStamp(sourcePath, size, time);
+		if (header.magic != MESH_CACHE_MAGIC || header.version != 1 || header.vertexSize != sizeof(Vertex) ||
+			header.sourceSize != size || header.sourceTime != time ||
+			cache->file->size() != sizeof(MeshCacheHeader) + header.vertexCount * sizeof(Vertex) + header.indexCount * sizeof(uint32_t))
+			return nullptr;
+		return cache;
+	}
+	catch (const std::exception&)
+	{
+		return nullptr;
+	}
+}
+
+void WriteMeshCache(const std::string& sourcePath, const MeshData& mesh)
+{
+	MeshCacheHeader header;
+	header.vertexCount = mesh.vertices.size();
+	header.indexCount = mesh.indices.size();
+	SourceStamp(sourcePath, header.sourceSize, header.sourceTime);
+	for (int i = 0; i < 3; i++)
+	{
+		header.minBounds[i] = mesh.minBounds[i];
+		header.maxBounds[i] = mesh.maxBounds[i];
+	}
+
+	// written under a temporary name, a reader never maps a half written cache
+	std::string path = CachePath(sourcePath);
+	std::string temporary = path + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(Vertex));
+		file.write(reinterpret_cast<const char*>(mesh.indices.data()), mesh.indices.size() * sizeof(uint32_t));
+		if (!file)
+			throw std::runtime_error("failed to write " + temporary);
+	}
+	std::filesystem::rename(temporary, path);
+}
+
+std::unique_ptr<Model> LoadModel(const std::string& path, const std::string& name)
+{
+	// deduplicated binary copy of the obj, mapped straight into the buffers
+	if (std::unique_ptr<MeshCache> cache = OpenMeshCache(path))
+	{
+		const MeshCacheHeader& header = cache->header;
+		return std::make_unique<Model>(path, name, cache->vertices(), header.vertexCount, cache->indices(), header.indexCount,
+			glm::vec3(header.minBounds[0], header.minBounds[1], header.minBounds[2]),
+			glm::vec3(header.maxBounds[0], header.maxBounds[1], header.maxBounds[2]));
+	}
+
+	a_attrib attrib;
+	a_shape shapes;
+	MeshData mesh;
+	if (!obj_load(path.c_str(), &attrib, &shapes, &mesh.minBounds, &mesh.maxBounds))
+		throw std::runtime_error("load " + path + " failure");
+
+	// check if the vertex appeared before to reduce redundant data
+	DeduplicateVertices(attrib, shapes, mesh);
+
+	try
+	{
+		WriteMeshCache(path, mesh);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "mesh cache not written: " << e.what() << std::endl;
+	}
+
+	return std::make_unique<Model>(path, name, mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size(),
+		mesh.minBounds, mesh.maxBounds);
+}
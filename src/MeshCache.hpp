@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "vertex.h"
+#include "MappedFile.hpp"
+#include "utils/objLoader.h"
+
+class Model;
+
+// Binary cache of a deduplicated OBJ, written next to it as <obj>.meshcache: a
+// MeshCacheHeader, then vertexCount interleaved Vertex, then indexCount uint32
+// indices. The mapping is handed to glBufferData as is. The cache is stale as
+// soon as the OBJ size or modification time differs from the recorded one.
+#define MESH_CACHE_MAGIC 0x48534D4Eu // "NMSH"
+
+struct MeshCacheHeader
+{
+	uint32_t magic = MESH_CACHE_MAGIC;
+	uint32_t version = 1;
+	uint32_t vertexSize = sizeof(Vertex);
+	uint32_t reserved = 0;
+	uint64_t vertexCount = 0;
+	uint64_t indexCount = 0;
+	uint64_t sourceSize = 0;
+	int64_t sourceTime = 0;
+	float minBounds[3] = {0.0f, 0.0f, 0.0f};
+	float maxBounds[3] = {0.0f, 0.0f, 0.0f};
+};
+
+struct MeshData
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	glm::vec3 minBounds = glm::vec3(0.0f);
+	glm::vec3 maxBounds = glm::vec3(0.0f);
+};
+
+struct MeshCache
+{
+	std::unique_ptr<MappedFile> file;
+	MeshCacheHeader header;
+
+	const Vertex* vertices() const { return reinterpret_cast<const Vertex*>(file->data() + sizeof(MeshCacheHeader)); }
+	const uint32_t* indices() const
+	{
+		return reinterpret_cast<const uint32_t*>(file->data() + sizeof(MeshCacheHeader) + header.vertexCount * sizeof(Vertex));
+	}
+};
+
+// one vertex per distinct (position, normal, texCoord), flat open-addressing table
+void DeduplicateVertices(const a_attrib& attrib, const a_shape& shapes, MeshData& mesh);
+
+// mapped cache of sourcePath, null when there is none or it is stale
+std::unique_ptr<MeshCache> OpenMeshCache(const std::string& sourcePath);
+
+void WriteMeshCache(const std::string& sourcePath, const MeshData& mesh);
+
+// model of the obj at path through its cache, the cache is (re)written after a parse
+std::unique_ptr<Model> LoadModel(const std::string& path, const std::string& name);
@@ -8,6 +8,8 @@
 #include "./NoiseSynth.hpp"
 #include "./GUI.hpp"
 #include "./Setup.hpp"
+#include "./ExemplarPyramid.hpp"
+#include "./MeshCache.hpp"
 
 // main renderloop
 void NoiseSynth::renderFrame()
@@ -17,12 +19,28 @@ void NoiseSynth::renderFrame()
 
 	showFpsInWindowTitle();
 
+	if(watchExemplar)
+		watchExemplarFiles();
+
 	glClearColor(_clearColor.r, _clearColor.g, _clearColor.b, _clearColor.a);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glEnable(GL_DEPTH_TEST);
 
 	// draw_debug_pass();
-	draw_blend_pass();
+	if(showLibrary && loadLibrary())
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		draw_library_pass(_windowWidth, _windowHeight);
+	}
+	else if(showMesh && updateExemplar() && loadMesh())
+		draw_mesh_pass();
+	else if(updateExemplar())
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		draw_blend_pass(_windowWidth, _windowHeight);
+	}
 	if(!hideGUI)
 		drawLightGUI();
 }
@@ -45,15 +63,138 @@ void NoiseSynth::draw_debug_pass()
 	rq->renderQuad();
 }
 
-void NoiseSynth::draw_blend_pass()
+void NoiseSynth::draw_blend_pass(int width, int height)
+{
+	glViewport(0, 0, width, height);
+
+	_synthShader->use();
+	_synthShader->setFloat("aspect_ratio",(float)width/(float)height);
+	// the per channel LUT stands in while the 3D one or the pyramid is built
+	bool lut3D = blendMode == 6 && updateLUT3D();
+	int firstBand = -1;
+	if(blendMode == 7)
+	{
+		// bands finer than a pixel are left out, lod as ComputeLOD for one viewport height per exemplar
+		float lod = std::log2((float)std::max(_exemplarWidth, _exemplarHeight) / (float)height);
+		firstBand = updatePyramid(FirstVisibleBand(lod, MAX_PYRAMID_BANDS));
+	}
+	bool fallback = (blendMode == 6 && !lut3D) || (blendMode == 7 && firstBand < 0);
+	_synthShader->setInt("blendMode",fallback ? 2 : blendMode);
+	if(firstBand >= 0)
+		bindPyramid(*_synthShader, firstBand, GL_TEXTURE4, GL_TEXTURE5);
+	_synthShader->setUint("hashSeed",(unsigned int)hashSeed);
+	bindSeamOffsets(*_synthShader, GL_TEXTURE6);
+	bindVertexOffsets(*_synthShader, GL_TEXTURE7);
+	if(animate)
+		_animationTime += _deltaTime * animationSpeed;
+	_synthShader->setInt("animate",animate ? 1 : 0);
+	_synthShader->setFloat("time",_animationTime);
+
+	glActiveTexture(GL_TEXTURE0);
+	_noiseTexture->bind();
+	glActiveTexture(GL_TEXTURE1);
+	_gaussianTexture->bind();
+	glActiveTexture(GL_TEXTURE2);
+	_invLutTexture->bind();
+	if(lut3D)
+	{
+		glActiveTexture(GL_TEXTURE3);
+		_invLut3DTexture->bind();
+	}
+
+	rq->renderQuad();
+}
+
+// loads the exemplar library once, library mode is disabled if it fails
+bool NoiseSynth::loadLibrary()
+{
+	if(_library)
+		return true;
+
+	try
+	{
+		_synthArrayShader.reset(new Shader(synthArrayVertCode, synthArrayFragCode));
+		_synthArrayShader->use();
+		_synthArrayShader->setInt("src_texture",0);
+		_synthArrayShader->setInt("gauss_texture",1);
+		_synthArrayShader->setInt("inv_lut_texture",2);
+		glUniformBlockBinding(_synthArrayShader->getID(),
+			glGetUniformBlockIndex(_synthArrayShader->getID(), "ExemplarColorSpaces"), 0);
+
+		_library.reset(new ExemplarLibrary(libraryPaths));
+	}
+	catch(const std::exception& e)
+	{
+		std::cerr << "Library mode disabled: " << e.what() << std::endl;
+		_library.reset();
+		showLibrary = false;
+		return false;
+	}
+	return true;
+}
+
+// (re)loads the preview mesh when the path changes, preview is disabled if it fails
+bool NoiseSynth::loadMesh()
+{
+	if(_mesh && _meshPath == meshPathBuffer)
+		return true;
+
+	try
+	{
+		if(!_meshShader)
+		{
+			_meshShader.reset(new Shader(meshVertCode, meshFragCode));
+			_meshShader->use();
+			_meshShader->setInt("src_texture",0);
+			_meshShader->setInt("gauss_texture",1);
+			_meshShader->setInt("inv_lut_texture",2);
+			_meshShader->setInt("inv_lut3d_texture",3);
+			_meshShader->setInt("seam_offset_texture",4);
+			_meshShader->setInt("vertex_offset_texture",5);
+			setColorSpace(*_meshShader);
+		}
+		_meshPath = meshPathBuffer;
+		_mesh = LoadModel(_meshPath, std::filesystem::path(_meshPath).filename().string());
+		std::cout << "Loaded mesh " << _meshPath << " (" << _mesh->getFaceCount() << " triangles)" << std::endl;
+	}
+	catch(const std::exception& e)
+	{
+		std::cerr << "Mesh preview disabled: " << e.what() << std::endl;
+		_mesh.reset();
+		showMesh = false;
+		return false;
+	}
+	return true;
+}
+
+// triplanar synthesis on the preview mesh, seen by an orbit camera around its bounds
+void NoiseSynth::draw_mesh_pass()
 {
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	glViewport(0, 0, _windowWidth, _windowHeight);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glEnable(GL_DEPTH_TEST);
 
-	_synthShader->use();
-	_synthShader->setFloat("aspect_ratio",(float)this->_windowWidth/(float)this->_windowHeight);
-	_synthShader->setInt("blendMode",blendMode);
+	glm::vec3 center = 0.5f * (_mesh->_min_vec + _mesh->_max_vec);
+	float radius = std::max(0.5f * glm::length(_mesh->_max_vec - _mesh->_min_vec), 1e-3f);
+	glm::vec3 eye = center + radius * _meshDistance *
+		glm::vec3(std::cos(_meshPitch) * std::sin(_meshYaw), std::sin(_meshPitch), std::cos(_meshPitch) * std::cos(_meshYaw));
+	glm::mat4 view = glm::lookAt(eye, center, glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)_windowWidth / (float)_windowHeight,
+		0.01f * radius, 100.0f * radius);
+
+	bool lut3D = blendMode == 6 && updateLUT3D();
+	_meshShader->use();
+	_meshShader->setMat4("model", glm::mat4(1.0f));
+	_meshShader->setMat4("view", view);
+	_meshShader->setMat4("projection", projection);
+	// the mesh preview has no multi-scale path, mode 7 shows the single scale LUT
+	_meshShader->setInt("blendMode", ((blendMode == 6 && !lut3D) || blendMode == 7) ? 2 : blendMode);
+	_meshShader->setUint("hashSeed", (unsigned int)hashSeed);
+	_meshShader->setFloat("noiseScale", meshNoiseScale);
+	_meshShader->setFloat("triplanarSharpness", triplanarSharpness);
+	bindSeamOffsets(*_meshShader, GL_TEXTURE4);
+	bindVertexOffsets(*_meshShader, GL_TEXTURE5);
 
 	glActiveTexture(GL_TEXTURE0);
 	_noiseTexture->bind();
@@ -61,12 +202,49 @@ void NoiseSynth::draw_blend_pass()
 	_gaussianTexture->bind();
 	glActiveTexture(GL_TEXTURE2);
 	_invLutTexture->bind();
+	if(lut3D)
+	{
+		glActiveTexture(GL_TEXTURE3);
+		_invLut3DTexture->bind();
+	}
 
-	rq->renderQuad();
+	_mesh->draw();
+}
+
+// all exemplars of the library in a grid, one instance each
+void NoiseSynth::draw_library_pass(int width, int height)
+{
+	int columns = (int)std::ceil(std::sqrt((float)_library->size()));
+	int rows = (_library->size() + columns - 1) / columns;
+
+	glViewport(0, 0, width, height);
+
+	_synthArrayShader->use();
+	_synthArrayShader->setFloat("aspect_ratio",((float)width/columns)/((float)height/rows));
+	_synthArrayShader->setInt("blendMode",blendMode);
+	_synthArrayShader->setUint("hashSeed",(unsigned int)hashSeed);
+	glUniform2i(glGetUniformLocation(_synthArrayShader->getID(), "gridSize"), columns, rows);
+
+	_library->bind(0);
+
+	rq->renderQuadInstanced(_library->size());
 }
 
 void NoiseSynth::handleInput()
 {
+	// mesh preview orbit, right drag rotates and the wheel zooms
+	MouseInput& mouse = _mouseInput;
+	if (showMesh && mouse.click.right && mouse.move.xOld >= 0.0)
+	{
+		_meshYaw -= (float)(mouse.move.xCurrent - mouse.move.xOld) * 0.01f;
+		_meshPitch = glm::clamp(_meshPitch + (float)(mouse.move.yCurrent - mouse.move.yOld) * 0.01f, -1.5f, 1.5f);
+	}
+	mouse.move.xOld = mouse.move.xCurrent;
+	mouse.move.yOld = mouse.move.yCurrent;
+	if (showMesh && mouse.scroll.y != 0.0)
+		_meshDistance = glm::clamp(_meshDistance * std::pow(0.9f, (float)mouse.scroll.y), 0.2f, 20.0f);
+	mouse.scroll.y = 0.0;
+
 	// handle input
 	if (_keyboardInput.keyStates[GLFW_KEY_SPACE] == GLFW_PRESS)
 	{
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <filesystem>
 #include <memory>
 #include <string>
 #include <random>
@@ -12,6 +13,17 @@
 #include "../base/camera.h"
 #include "../base/skybox.h"
 #include "RenderQuad.h"
+#include "ComputeSynth.hpp"
+#include "ExemplarLibrary.hpp"
+#include "TextureLoader.hpp"
+#include "VertexOffsets.hpp"
+
+struct ExemplarPrecompute;
+struct ExemplarFile;
+struct InverseLUT3D;
+class ExemplarPyramid;
+struct SeamOffsetTable;
+struct SynthOptions;
 
 //HERE ARE THE PATH TO CHANGE, one is input, one is gaussianized input
 const std::string noiseTexturePath = "../data/noise/granite_256.png";
@@ -22,17 +34,58 @@ const std::string synthVertCode = "../shader/synth.vs";
 const std::string synthFragCode = "../shader/synth.fs";
 const std::string debugVertCode = "../shader/debug.vs";
 const std::string debugFragCode = "../shader/debug.fs";
+const std::string synthCompCode = "../shader/synth.comp";
+const std::string synth3dCompCode = "../shader/synth3d.comp";
+const std::string synthArrayVertCode = "../shader/synth_array.vs";
+const std::string synthArrayFragCode = "../shader/synth_array.fs";
+const std::string meshVertCode = "../shader/mesh.vs";
+const std::string meshFragCode = "../shader/mesh.fs";
+
+//Exemplars synthesized together in library mode, they must share the same size
+const std::vector<ExemplarPaths> libraryPaths = {
+	{"../data/noise/bricks_256.png", "../gaussian_output/bricks_256_g.png"},
+	{"../data/noise/cement_256.png", "../gaussian_output/cement_256_g.png"},
+	{"../data/noise/crystal_256.png", "../gaussian_output/crystal_256_g.png"},
+	{"../data/noise/fire_256.png", "../gaussian_output/fire_256_g.png"},
+	{"../data/noise/granite_256.png", "../gaussian_output/granite_256_g.png"},
+	{"../data/noise/grass_256.png", "../gaussian_output/grass_256_g.png"},
+	{"../data/noise/marble_256.png", "../gaussian_output/marble_256_g.png"},
+	{"../data/noise/tiles_256.png", "../gaussian_output/tiles_256_g.png"},
+	{"../data/noise/wood_256.png", "../gaussian_output/wood_256_g.png"},
+};
 const int fps = 40;
 
 class NoiseSynth : public Application
 {
 public:
-	NoiseSynth(const std::string &basedir);
+	NoiseSynth(const std::string &basedir, bool headless = false);
 
 	~NoiseSynth();
 
 	std::unique_ptr<RenderQuad> rq;
 
+	// Hash Seed of the GUI, for the bakes below
+	void setHashSeed(int seed) { hashSeed = seed; }
+
+	// blendMode of the GUI, for the bakes below
+	void setBlendMode(int mode) { blendMode = mode; }
+
+	// Seam-aware and precomputed offsets of the GUI, for the bakes below
+	void setSynthOptions(const SynthOptions& options);
+
+	// Synthesizes a width x height image with the compute path (one exemplar texel per pixel)
+	bool bakeCompute(int width, int height, const std::string& filename);
+
+	// Synthesizes a size^3 bricked volume with the compute path (one exemplar texel per voxel)
+	bool bakeVolumeCompute(int size, const std::string& filename);
+
+	// Synthesizes every exemplar of libraryPaths in one instanced pass, one cellSize^2 image each
+	bool bakeLibrary(int cellSize, const std::string& directory);
+
+	// Renders every blendMode at the golden viewports through synth.fs and the CPU reference,
+	// returns the number of failed comparisons; update rewrites the references instead
+	int checkGolden(const std::string& directory, bool update);
+
 private:
 
 	void handleInput() override;
@@ -41,11 +94,83 @@ private:
 	//synth shader
 	std::unique_ptr<Shader> _synthShader;
 	//synth noise texture
-	std::unique_ptr<Texture> _noiseTexture;
+	std::shared_ptr<Texture2D> _noiseTexture;
 	//synth noise texture
-	std::unique_ptr<Texture> _gaussianTexture;
+	std::shared_ptr<Texture2D> _gaussianTexture;
 	//inv_T transformation
 	std::unique_ptr<Texture> _invLutTexture;
+	//joint inverse transformation, built in the background when blendMode 6 is first used
+	std::unique_ptr<Texture3D> _invLut3DTexture;
+	int _lut3DTextureSize = 0;
+	int _lut3DTextureGeneration = 0;
+	std::future<std::shared_ptr<InverseLUT3D>> _pendingLUT3D;
+	int _lut3DRequestSize = 0;
+	int _lut3DRequestGeneration = 0;
+	//good offset cells of a non-tileable exemplar, null when it tiles
+	std::unique_ptr<Texture2D> _seamOffsetTexture;
+	//precomputed per-vertex offsets, rebuilt in the background when their GUI parameters change
+	std::shared_ptr<const VertexOffsetTable> _vertexOffsets;
+	std::unique_ptr<Texture2D> _vertexOffsetTexture;
+	std::future<std::shared_ptr<const VertexOffsetTable>> _pendingVertexOffsets;
+	VertexOffsetParameters _vertexOffsetRequest;
+	bool _vertexOffsetRequested = false;
+	//multi-scale pyramid, bands built in the background as blendMode 7 views need them
+	std::shared_ptr<const ExemplarPyramid> _pyramid;
+	std::unique_ptr<Texture2DArray> _bandGaussianTexture;
+	std::unique_ptr<Texture2DArray> _bandLutTexture;
+	unsigned int _uploadedBands = 0;
+	int _pyramidGeneration = 0;
+	std::future<std::shared_ptr<const ExemplarPyramid>> _pendingPyramid;
+	int _pyramidRequestBand = 0;
+	int _pyramidRequestGeneration = 0;
+	//compute synthesis, null when the context is older than 4.3
+	std::unique_ptr<ComputeSynth> _computeSynth;
+	std::unique_ptr<ComputeVolumeSynth> _computeVolumeSynth;
+	int _exemplarWidth = 0;
+	int _exemplarHeight = 0;
+	//time of the animated lattice
+	float _animationTime = 0.0f;
+
+	//asynchronous exemplar loading
+	std::unique_ptr<TextureLoader> _loader;
+	bool _exemplarReady = false;
+
+	//exemplar being loaded, swapped in as a whole once complete
+	struct PendingExemplar
+	{
+		int generation = 0;
+		std::string noisePath;
+		std::string gaussianPath;
+		std::shared_ptr<Texture2D> noise;
+		std::shared_ptr<Texture2D> gaussian;
+		int uploads = 0;
+		bool failed = false;
+		std::future<std::shared_ptr<ExemplarPrecompute>> precompute;
+		std::future<std::shared_ptr<const SeamOffsetTable>> seamOffsets;
+		// .nsx exemplars are uploaded straight from the mapping
+		std::shared_future<std::shared_ptr<const ExemplarFile>> file;
+	};
+	std::unique_ptr<PendingExemplar> _pendingExemplar;
+	int _exemplarGeneration = 0;
+
+	//hot reload of the exemplar files
+	std::string _noisePath;
+	std::string _gaussianPath;
+	std::filesystem::file_time_type _noiseWriteTime;
+	std::filesystem::file_time_type _gaussianWriteTime;
+	float _watchTimer = 0.0f;
+
+	//mesh preview, loaded on first use
+	std::unique_ptr<Shader> _meshShader;
+	std::unique_ptr<Model> _mesh;
+	std::string _meshPath;
+	float _meshYaw = 0.6f;
+	float _meshPitch = 0.4f;
+	float _meshDistance = 2.5f;
+
+	//library mode, loaded on first use
+	std::unique_ptr<Shader> _synthArrayShader;
+	std::unique_ptr<ExemplarLibrary> _library;
 
 	//decorrelation related variables
 	glm::vec3 colorSpaceVec1;
@@ -55,8 +180,29 @@ private:
 
 	//GUI
 	int blendMode = 0;
+	int hashSeed = 0;
+	bool seamAware = true;
+	bool offsetTable = false;
+	int offsetTableLog2 = 8;
+	// largest window rotation in radians and shrink fraction of the table offsets
+	float offsetRotation = 0.0f;
+	float offsetScale = 0.0f;
+	int lut3DSize = 32;
+	bool animate = false;
+	// lattice units per second along the time axis
+	float animationSpeed = 0.25f;
 	bool hideGUI = false;
 	char input_buffer[256] = "";
+	int bakeSize[2] = {4096, 4096};
+	bool showLibrary = false;
+	bool showMesh = false;
+	char meshPathBuffer[256] = "";
+	// exemplar repeats per mesh unit and triplanar transition sharpness
+	float meshNoiseScale = 1.0f;
+	float triplanarSharpness = 4.0f;
+	bool watchExemplar = true;
+	char noisePathBuffer[256] = "";
+	char gaussianPathBuffer[256] = "";
 
 	void renderFrame() override;
 
@@ -64,7 +210,43 @@ private:
 
 	void draw_debug_pass();
 
-	void draw_blend_pass();
+	void draw_blend_pass(int width, int height);
+
+	void requestExemplar(const std::string& noisePath, const std::string& gaussianPath);
+
+	void applyPrecompute(const ExemplarPrecompute& precompute);
+
+	void setColorSpace(Shader& shader);
+
+	void bindSeamOffsets(Shader& shader, GLenum unit);
+
+	void bindPyramid(Shader& shader, int firstBand, GLenum gaussianUnit, GLenum lutUnit);
+
+	VertexOffsetParameters vertexOffsetParameters() const;
+
+	std::shared_ptr<const VertexOffsetTable> updateVertexOffsets();
+
+	std::shared_ptr<const VertexOffsetTable> waitForVertexOffsets();
+
+	void bindVertexOffsets(Shader& shader, GLenum unit);
+
+	bool updateExemplar();
+
+	bool waitForExemplar();
+
+	bool updateLUT3D();
+
+	int updatePyramid(int firstBand);
+
+	void watchExemplarFiles();
+
+	bool loadLibrary();
+
+	void draw_library_pass(int width, int height);
+
+	bool loadMesh();
+
+	void draw_mesh_pass();
 
 #ifdef __APPLE__
 	// Captures the current OpenGL framebuffer and saves it to a file
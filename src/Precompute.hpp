@@ -1,5 +1,9 @@
 #pragma once
-#include "NoiseSynth.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
 #include "jacobi.h"
 #include "TextureDataFloat.hpp"
 // Ref: https://eheitzresearch.wordpress.com/738-2/
@@ -9,7 +13,7 @@
 using glm::vec3;
 using glm::vec2;
 
-float erfinv(float x)
+inline float erfinv(float x)
 {
 	float w, p;
 	w = -log((1.0f - x) * (1.0f + x));
@@ -42,21 +46,21 @@ float erfinv(float x)
 	return p * x;
 }
 
-float CDF(float x, float mu, float sigma)
+inline float CDF(float x, float mu, float sigma)
 {
 	float U = 0.5f * (1 + erf((x-mu)/(sigma*sqrtf(2.0f))));
 	return U;
 }
 
-float invCDF(float U, float mu, float sigma)
+inline float invCDF(float U, float mu, float sigma)
 {
 	float x = sigma*sqrtf(2.0f) * erfinv(2.0f*U-1.0f) + mu;
 	return x;
 }
 
-void ComputeinvT(TextureDataFloat& input, TextureDataFloat& Tinv, int channel)
+// Sorted values of one channel, the exact inverse transformation is a lookup in them
+inline std::vector<float> SortChannel(TextureDataFloat& input, int channel)
 {
-	// Sort pixels of example image
 	std::vector<float> sortedInputValues;
 	sortedInputValues.resize(input.width * input.height);
 	for (int y = 0; y < input.height; y++)
@@ -66,25 +70,59 @@ void ComputeinvT(TextureDataFloat& input, TextureDataFloat& Tinv, int channel)
 	}
 
 	sort(sortedInputValues.begin(), sortedInputValues.end());
+	return sortedInputValues;
+}
+
+// Input value of the Gaussian value G in [0, 1]
+inline float InverseTransform(const std::vector<float>& sortedInputValues, float G)
+{
+	// Quantile value 
+	float U = CDF(G, GAUSSIAN_AVERAGE, GAUSSIAN_STD);
+	// Find quantile in sorted pixel values
+	int index = std::min((int)floor(U * sortedInputValues.size()), (int)sortedInputValues.size() - 1);
+	return sortedInputValues[index];
+}
 
+inline void ComputeinvT(const std::vector<float>& sortedInputValues, TextureDataFloat& Tinv, int channel)
+{
 	// Generate Tinv look-up table 
 	for (int i = 0; i < Tinv.width; i++)
 	{
 		// Gaussian value in [0, 1]
 		float G = (i + 0.5f) / (Tinv.width);
-		// Quantile value 
-		float U = CDF(G, GAUSSIAN_AVERAGE, GAUSSIAN_STD);
-		// Find quantile in sorted pixel values
-		int index = (int)floor(U * sortedInputValues.size());
-		// Get input value 
-		float I = sortedInputValues[index];
 		// Store in LUT
-		Tinv.SetPixel(i, 0, channel, I);
+		Tinv.SetPixel(i, 0, channel, InverseTransform(sortedInputValues, G));
+	}
+}
+
+inline void ComputeinvT(TextureDataFloat& input, TextureDataFloat& Tinv, int channel)
+{
+	ComputeinvT(SortChannel(input, channel), Tinv, channel);
+}
+
+// Forward transformation T: every pixel gets the Gaussian value of its rank,
+// what gaussianize.py does offline for the exemplar
+inline void ComputeT(TextureDataFloat& input, TextureDataFloat& gaussian, int channel)
+{
+	int n = input.width * input.height;
+	std::vector<float> values(n);
+	std::vector<int> order(n);
+	for (int i = 0; i < n; i++)
+	{
+		values[i] = input.GetPixel(i % input.width, i / input.width, channel);
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&](int a, int b) { return values[a] < values[b]; });
+
+	for (int rank = 0; rank < n; rank++)
+	{
+		float G = invCDF((rank + 0.5f) / n, GAUSSIAN_AVERAGE, GAUSSIAN_STD);
+		gaussian.SetPixel(order[rank] % input.width, order[rank] / input.width, channel, std::max(0.0f, std::min(1.0f, G)));
 	}
 }
 
 
-void ComputeEigenVectors(TextureDataFloat& input, vec3 eigenVectors[3])
+inline void ComputeEigenVectors(TextureDataFloat& input, vec3 eigenVectors[3])
 {
 	// First and second order moments
 	float R=0, G=0, B=0, RR=0, GG=0, BB=0, RG=0, RB=0, GB=0;
@@ -136,7 +174,7 @@ void ComputeEigenVectors(TextureDataFloat& input, vec3 eigenVectors[3])
 }
 
 // PCA, this is required if we gonna do transformation per channel
-void DecorrelateColorSpace(
+inline void DecorrelateColorSpace(
  TextureDataFloat& input,			  // input: example image
  TextureDataFloat& input_decorrelated,// output: decorrelated input 
  vec3& colorSpaceVector1,			  // output: color space vector1 
@@ -162,7 +200,7 @@ void DecorrelateColorSpace(
 	}
 
 	// Compute ranges of the new color space
-	vec2 colorSpaceRanges[3] = {vec2(FLT_MAX,FLT_MIN), vec2(FLT_MAX,FLT_MIN), vec2(FLT_MAX,FLT_MIN)};
+	vec2 colorSpaceRanges[3] = {vec2(FLT_MAX,-FLT_MAX), vec2(FLT_MAX,-FLT_MAX), vec2(FLT_MAX,-FLT_MAX)};
 	for (int y = 0; y < input.height; y++)
 	for (int x = 0; x < input.width; x++)
 	for(int channel = 0 ; channel < 3 ; ++channel)
@@ -200,7 +238,7 @@ void DecorrelateColorSpace(
 }
 
 // Compute average subpixel variance at a given LOD
-float ComputeLODAverageSubpixelVariance(TextureDataFloat& image, int LOD, int channel)
+inline float ComputeLODAverageSubpixelVariance(TextureDataFloat& image, int LOD, int channel)
 {
 	// Window width associated with
 	int windowWidth = 1 << LOD;
@@ -233,11 +271,12 @@ float ComputeLODAverageSubpixelVariance(TextureDataFloat& image, int LOD, int ch
 	return average_window_variance;
 }
 
-// Filter LUT by sampling a Gaussian N(mu, std)
-float FilterLUTValueAtx(TextureDataFloat& LUT, float x, float std, int channel)
+// Filter LUT by sampling a Gaussian N(mu, std), numberOfSamples 0 for the
+// heuristic of twice the LUT resolution
+inline float FilterLUTValueAtx(const TextureDataFloat& LUT, float x, float std, int channel, int numberOfSamples = 0)
 {
-	// Number of samples for filtering (heuristic: twice the LUT resolution)
-	const int numberOfSamples = 2 * 128;
+	if (numberOfSamples <= 0)
+		numberOfSamples = 2 * LUT.width;
 
 	// Filter
 	float filtered_value = 0.0f;
@@ -248,7 +287,7 @@ float FilterLUTValueAtx(TextureDataFloat& LUT, float x, float std, int channel)
 		// Sample the Gaussian 
 		float sample_x = invCDF(U, x, std);
 		// Find sample texel in LUT (the LUT covers the domain [0, 1])
-		int sample_texel = fmax(0, fmin(128 - 1, (int)floor(sample_x * 128)));
+		int sample_texel = fmax(0, fmin(LUT.width - 1, (int)floor(sample_x * LUT.width)));
 		// Fetch LUT at level 0
 		float sample_value = LUT.GetPixel(sample_texel, 0, channel);
 		// Accumulate
@@ -259,11 +298,12 @@ float FilterLUTValueAtx(TextureDataFloat& LUT, float x, float std, int channel)
 	return filtered_value;
 }
 
-// Filter LUT
-void PrefilterLUT(TextureDataFloat& image_T_Input, TextureDataFloat& LUT_Tinv, int channel)
+// Filter LUT, row LOD holds the LUT prefiltered for the subpixel variance of
+// that mip level of the gaussianized exemplar, row 0 stays unfiltered
+inline void PrefilterLUT(TextureDataFloat& image_T_Input, TextureDataFloat& LUT_Tinv, int channel, int numberOfSamples = 0)
 {
 	// Compute number of prefiltered levels and resize LUT
-	LUT_Tinv.height = (int)(log((float)image_T_Input.width)/log(2.0f));
+	LUT_Tinv.height = (int)(log((float)std::min(image_T_Input.width, image_T_Input.height))/log(2.0f));
 	LUT_Tinv.data.resize(3 * LUT_Tinv.width * LUT_Tinv.height);
 	
 	// Prefilter 
@@ -279,9 +319,192 @@ void PrefilterLUT(TextureDataFloat& image_T_Input, TextureDataFloat& LUT_Tinv, i
 			// Texel position in [0, 1]
 			float x_texel = (i+0.5f) / LUT_Tinv.width;
 			// Filter look-up table around this position with Gaussian kernel
-			float filteredValue = FilterLUTValueAtx(LUT_Tinv, x_texel, window_std, channel);
+			float filteredValue = FilterLUTValueAtx(LUT_Tinv, x_texel, window_std, channel, numberOfSamples);
 			// Store filtered value
 			LUT_Tinv.SetPixel(i, LOD, channel, filteredValue);
 		}
 	}
+}
+
+// widest LUT, the row synth.comp caches in shared memory (MAX_LUT_WIDTH) holds no more
+#define LUT_MAX_WIDTH 1024
+
+// LUT resolution for an exemplar: a LUT cannot resolve more quantiles than the
+// exemplar has pixels, half the square root of the pixel count keeps the
+// 128 texels that were used for the 256^2 exemplars and grows slowly beyond
+inline int ChooseLUTWidth(const TextureDataFloat& input)
+{
+	float target = 0.5f * sqrtf((float)input.width * input.height);
+	int width = 32;
+	while (width < target && width < LUT_MAX_WIDTH)
+		width *= 2;
+	return width;
+}
+
+// Target of the LUT tuner: mean error of the inverse transformation over the
+// Gaussian distribution, in units of the decorrelated channel range
+#define LUT_TARGET_ERROR (0.5f / 255.0f)
+
+// LUT width and prefilter sample count of one exemplar, with the error they reach
+struct LUTParameters
+{
+	int width = 0;
+	int filterSamples = 0;
+	float error = 0.0f;
+};
+
+// Mean error of a width texel LUT against the exact transformation, for
+// reference Gaussian values of equal probability, looked up like LookupLUT
+inline float LUTWidthError(const std::vector<float>& sortedInputValues,
+	const std::vector<float>& referenceG, const std::vector<float>& referenceI, int width)
+{
+	std::vector<float> lut(width);
+	for (int i = 0; i < width; i++)
+		lut[i] = InverseTransform(sortedInputValues, (i + 0.5f) / width);
+
+	double error = 0.0;
+	for (size_t k = 0; k < referenceG.size(); k++)
+	{
+		float x = std::max(0.0f, std::min(referenceG[k] * width - 0.5f, (float)(width - 1)));
+		int i0 = (int)std::floor(x);
+		int i1 = std::min(i0 + 1, width - 1);
+		float t = x - i0;
+		error += std::abs(lut[i0] * (1.0f - t) + lut[i1] * t - referenceI[k]);
+	}
+	return (float)(error / referenceG.size());
+}
+
+// Smallest LUT width (16 to LUT_MAX_WIDTH) and prefilter sample count whose mean error
+// stays below targetError on every channel. The channels are sorted once, every
+// candidate is then a lookup in the sorted values. The prefilter kernels are
+// measured on the gaussianized exemplar like in PrefilterLUT.
+inline LUTParameters TuneLUTParameters(TextureDataFloat& image_T_Input,
+	const std::vector<float> sortedChannels[3], float targetError = LUT_TARGET_ERROR)
+{
+	// Gaussian values of equal probability, clamped to the LUT domain as G_cov is
+	const int references = 4096;
+	std::vector<float> referenceG(references);
+	for (int k = 0; k < references; k++)
+		referenceG[k] = std::max(0.0f, std::min(1.0f, invCDF((k + 0.5f) / references, GAUSSIAN_AVERAGE, GAUSSIAN_STD)));
+
+	std::vector<float> referenceI[3];
+	for (int channel = 0; channel < 3; channel++)
+	{
+		referenceI[channel].resize(references);
+		for (int k = 0; k < references; k++)
+			referenceI[channel][k] = InverseTransform(sortedChannels[channel], referenceG[k]);
+	}
+	auto widthError = [&](int width) {
+		float error = 0.0f;
+		for (int channel = 0; channel < 3; channel++)
+			error = std::max(error, LUTWidthError(sortedChannels[channel], referenceG, referenceI[channel], width));
+		return error;
+	};
+
+	LUTParameters parameters;
+	parameters.width = 16;
+	parameters.error = widthError(parameters.width);
+	while (parameters.width < LUT_MAX_WIDTH && parameters.error > targetError)
+	{
+		parameters.width *= 2;
+		parameters.error = widthError(parameters.width);
+	}
+
+	// prefilter samples against a dense reference, at the kernel widths of every LOD
+	TextureDataFloat lut(parameters.width, 1, 3);
+	std::vector<float> windowStd[3];
+	for (int channel = 0; channel < 3; channel++)
+	{
+		ComputeinvT(sortedChannels[channel], lut, channel);
+		for (int LOD = 1; (1 << LOD) < std::min(image_T_Input.width, image_T_Input.height); LOD++)
+			windowStd[channel].push_back(sqrtf(ComputeLODAverageSubpixelVariance(image_T_Input, LOD, channel)));
+	}
+	const int referenceSamples = 8 * parameters.width;
+	for (parameters.filterSamples = parameters.width / 4; parameters.filterSamples < referenceSamples; parameters.filterSamples *= 2)
+	{
+		double error = 0.0;
+		int count = 0;
+		for (int channel = 0; channel < 3; channel++)
+		for (float std : windowStd[channel])
+		for (int i = 0; i < parameters.width; i++)
+		{
+			float x = (i + 0.5f) / parameters.width;
+			error += std::abs(FilterLUTValueAtx(lut, x, std, channel, parameters.filterSamples) -
+				FilterLUTValueAtx(lut, x, std, channel, referenceSamples));
+			count++;
+		}
+		if (count == 0 || error / count <= targetError)
+			break;
+	}
+	return parameters;
+}
+
+// Products of the precomputation that the synthesis needs for one exemplar
+struct ExemplarPrecompute
+{
+	int width = 0;
+	int height = 0;
+	TextureDataFloat Tinv;
+	LUTParameters lutParameters;
+	vec3 colorSpaceVec1;
+	vec3 colorSpaceVec2;
+	vec3 colorSpaceVec3;
+	vec3 colorSpaceOrigin;
+};
+
+// Decorrelate the exemplar, compute the per channel inverse transformation and
+// with prefilter spread it over one LUT row per LOD with parameters.filterSamples;
+// without, the single unfiltered row is kept for the uses that upload one row
+// per exemplar (library layers, pyramid bands, volume exemplars). A zero
+// parameters.width tunes the LUT parameters with TuneLUTParameters. With
+// gaussianized the decorrelated exemplar run through T is returned too, the
+// pair matches like the outputs of gaussianize.py.
+inline void PrecomputeExemplar(TextureDataFloat& input, ExemplarPrecompute& out, const LUTParameters& parameters,
+	bool prefilter, TextureDataFloat* gaussianized = nullptr)
+{
+	out.width = input.width;
+	out.height = input.height;
+
+	// note that to perform an approximate OT through histogram normalization
+	// a decorrelation step is required (i.e. PCA)
+	TextureDataFloat input_decorrelated = TextureDataFloat(input.width, input.height, 3);
+	DecorrelateColorSpace(input, input_decorrelated,
+		out.colorSpaceVec1, out.colorSpaceVec2, out.colorSpaceVec3, out.colorSpaceOrigin);
+
+	//calculating inverse transformation, the sorted channels serve the tuner too
+	std::vector<float> sortedChannels[3];
+	for(int channel = 0 ; channel < 3 ; channel++)
+		sortedChannels[channel] = SortChannel(input_decorrelated, channel);
+
+	// the prefilter kernels live in the domain of the LUT, the gaussianized exemplar
+	TextureDataFloat input_T;
+	bool tune = parameters.width <= 0;
+	if(prefilter || tune || gaussianized)
+	{
+		input_T = TextureDataFloat(input.width, input.height, 3);
+		for(int channel = 0 ; channel < 3 ; channel++)
+			ComputeT(input_decorrelated, input_T, channel);
+	}
+
+	out.lutParameters = tune ? TuneLUTParameters(input_T, sortedChannels) : parameters;
+
+	out.Tinv = TextureDataFloat(out.lutParameters.width, 1, 3);
+	for(int channel = 0 ; channel < 3 ; channel++)
+	{
+		ComputeinvT(sortedChannels[channel], out.Tinv, channel);
+		if(prefilter)
+			PrefilterLUT(input_T, out.Tinv, channel, out.lutParameters.filterSamples);
+	}
+
+	if(gaussianized)
+		*gaussianized = std::move(input_T);
+}
+
+// fixed lutWidth (0 tunes it) and a single unfiltered LUT row
+inline void PrecomputeExemplar(TextureDataFloat& input, ExemplarPrecompute& out, int lutWidth,
+	TextureDataFloat* gaussianized = nullptr)
+{
+	LUTParameters parameters;
+	parameters.width = lutWidth;
+	PrecomputeExemplar(input, out, parameters, false, gaussianized);
 }
\ No newline at end of file
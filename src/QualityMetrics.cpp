@@ -0,0 +1,349 @@
+#include "QualityMetrics.hpp"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstring>
+
+ImageStatistics::ImageStatistics(int spectrumTile)
+	: spectrumTile(spectrumTile),
+	  spectrum(spectrumTile > 0 ? spectrumTile / 2 + 1 : 0, 0.0),
+	  spectrumSamples(spectrum.size(), 0)
+{
+}
+
+void ImageStatistics::merge(const ImageStatistics& other)
+{
+	for (int channel = 0; channel < 3; channel++)
+		for (int level = 0; level < 256; level++)
+			histogram[channel][level] += other.histogram[channel][level];
+	pixels += other.pixels;
+	for (int i = 0; i < 3; i++)
+	{
+		sum[i] += other.sum[i];
+		for (int j = 0; j < 3; j++)
+			sumProducts[i][j] += other.sumProducts[i][j];
+	}
+	if (spectrum.size() == other.spectrum.size())
+		for (size_t r = 0; r < spectrum.size(); r++)
+		{
+			spectrum[r] += other.spectrum[r];
+			spectrumSamples[r] += other.spectrumSamples[r];
+		}
+}
+
+float WassersteinDistance(const std::array<uint64_t, 256>& a, const std::array<uint64_t, 256>& b)
+{
+	double countA = 0.0, countB = 0.0;
+	for (int level = 0; level < 256; level++)
+	{
+		countA += (double)a[level];
+		countB += (double)b[level];
+	}
+	if (countA == 0.0 || countB == 0.0)
+		return 0.0f;
+
+	// in 1D the Wasserstein distance is the area between the two CDFs
+	double cdfA = 0.0, cdfB = 0.0, distance = 0.0;
+	for (int level = 0; level < 256; level++)
+	{
+		cdfA += a[level] / countA;
+		cdfB += b[level] / countB;
+		distance += std::abs(cdfA - cdfB);
+	}
+	return (float)(distance / 255.0);
+}
+
+int ChooseSpectrumTile(int width, int height)
+{
+	int tile = 1;
+	while (tile * 2 <= std::min(128, std::min(width, height)))
+		tile *= 2;
+	return tile >= 8 ? tile : 0;
+}
+
+namespace
+{
+// in place radix 2 FFT of n = 2^k values spaced by stride
+void FFT(std::complex<float>* data, int n, int stride)
+{
+	for (int i = 1, j = 0; i < n; i++)
+	{
+		int bit = n >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j)
+			std::swap(data[i * stride], data[j * stride]);
+	}
+	for (int length = 2; length <= n; length <<= 1)
+	{
+		std::complex<float> step = std::polar(1.0f, -6.28318531f / length);
+		for (int i = 0; i < n; i += length)
+		{
+			std::complex<float> w(1.0f);
+			for (int k = 0; k < length / 2; k++)
+			{
+				std::complex<float> a = data[(i + k) * stride];
+				std::complex<float> b = data[(i + k + length / 2) * stride] * w;
+				data[(i + k) * stride] = a + b;
+				data[(i + k + length / 2) * stride] = a - b;
+				w *= step;
+			}
+		}
+	}
+}
+
+// radially averaged power of the luminance of one tile x tile block
+void AccumulateSpectrum(const unsigned char* rgba, int width, int x0, ImageStatistics& statistics)
+{
+	int n = statistics.spectrumTile;
+	std::vector<std::complex<float>> tile((size_t)n * n);
+	std::vector<float> window(n);
+	float windowEnergy = 0.0f;
+	for (int i = 0; i < n; i++)
+		window[i] = 0.5f - 0.5f * std::cos(6.28318531f * (i + 0.5f) / n);
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++)
+			windowEnergy += window[i] * window[i] * window[j] * window[j];
+
+	// the mean is removed so the window does not leak it into the low frequencies
+	float mean = 0.0f;
+	for (int y = 0; y < n; y++)
+		for (int x = 0; x < n; x++)
+		{
+			const unsigned char* p = rgba + ((size_t)y * width + x0 + x) * 4;
+			float luminance = (0.2126f * p[0] + 0.7152f * p[1] + 0.0722f * p[2]) * (1.0f / 255.0f);
+			tile[(size_t)y * n + x] = luminance;
+			mean += luminance;
+		}
+	mean /= (float)n * n;
+	for (int y = 0; y < n; y++)
+		for (int x = 0; x < n; x++)
+			tile[(size_t)y * n + x] = (tile[(size_t)y * n + x] - mean) * window[x] * window[y];
+
+	for (int y = 0; y < n; y++)
+		FFT(&tile[(size_t)y * n], n, 1);
+	for (int x = 0; x < n; x++)
+		FFT(&tile[x], n, n);
+
+	for (int y = 0; y < n; y++)
+		for (int x = 0; x < n; x++)
+		{
+			int fx = x <= n / 2 ? x : x - n, fy = y <= n / 2 ? y : y - n;
+			int radius = (int)std::lround(std::sqrt((float)(fx * fx + fy * fy)));
+			if (radius > n / 2)
+				continue;
+			statistics.spectrum[radius] += std::norm(tile[(size_t)y * n + x]) / windowEnergy;
+			statistics.spectrumSamples[radius]++;
+		}
+}
+}
+
+void AccumulateStatistics(const unsigned char* rgba, int width, int rows, int x0, int x1,
+	const ExemplarPrecompute& basis, ImageStatistics& statistics)
+{
+	// coordinates of DecorrelateColorSpace, the inverse of ReturnToOriginalColorSpace
+	glm::vec3 axes[3] = {basis.colorSpaceVec1, basis.colorSpaceVec2, basis.colorSpaceVec3};
+	for (auto& axis : axes)
+	{
+		float length2 = glm::dot(axis, axis);
+		axis = length2 > 0.0f ? axis / length2 : glm::vec3(0.0f);
+	}
+
+	for (int y = 0; y < rows; y++)
+		for (int x = x0; x < x1; x++)
+		{
+			const unsigned char* p = rgba + ((size_t)y * width + x) * 4;
+			glm::vec3 color = glm::vec3(p[0], p[1], p[2]) * (1.0f / 255.0f) - basis.colorSpaceOrigin;
+			double d[3];
+			for (int i = 0; i < 3; i++)
+			{
+				statistics.histogram[i][p[i]]++;
+				d[i] = glm::dot(color, axes[i]);
+			}
+			for (int i = 0; i < 3; i++)
+			{
+				statistics.sum[i] += d[i];
+				for (int j = 0; j < 3; j++)
+					statistics.sumProducts[i][j] += d[i] * d[j];
+			}
+		}
+	statistics.pixels += (uint64_t)rows * (x1 - x0);
+
+	int n = statistics.spectrumTile;
+	if (n == 0 || rows != n)
+		return;
+	for (int x = (x0 + n - 1) / n * n; x + n <= x1; x += n)
+		AccumulateSpectrum(rgba, width, x, statistics);
+}
+
+ImageStatistics ComputeStatistics(const TextureDataFloat& image, const ExemplarPrecompute& basis,
+	int spectrumTile, ThreadPool& pool)
+{
+	std::vector<unsigned char> rgba((size_t)image.width * image.height * 4);
+	for (int y = 0; y < image.height; y++)
+		for (int x = 0; x < image.width; x++)
+		{
+			glm::vec3 color = glm::clamp(image.GetColorAt(x, y), 0.0f, 1.0f);
+			unsigned char* p = &rgba[((size_t)y * image.width + x) * 4];
+			p[0] = (unsigned char)std::lround(color.r * 255.0f);
+			p[1] = (unsigned char)std::lround(color.g * 255.0f);
+			p[2] = (unsigned char)std::lround(color.b * 255.0f);
+			p[3] = 255;
+		}
+
+	int stripRows = spectrumTile > 0 ? spectrumTile : 64;
+	std::vector<std::future<ImageStatistics>> strips;
+	for (int y = 0; y < image.height; y += stripRows)
+	{
+		int rows = std::min(stripRows, image.height - y);
+		const unsigned char* strip = &rgba[(size_t)y * image.width * 4];
+		int width = image.width;
+		strips.push_back(pool.submit([strip, width, rows, &basis, spectrumTile] {
+			ImageStatistics statistics(spectrumTile);
+			AccumulateStatistics(strip, width, rows, 0, width, basis, statistics);
+			return statistics;
+		}));
+	}
+
+	ImageStatistics statistics(spectrumTile);
+	for (auto& strip : strips)
+		statistics.merge(strip.get());
+	return statistics;
+}
+
+QualityReport CompareStatistics(const ImageStatistics& exemplar, const ImageStatistics& output)
+{
+	QualityReport report;
+	for (int channel = 0; channel < 3; channel++)
+		report.wasserstein[channel] = WassersteinDistance(exemplar.histogram[channel], output.histogram[channel]);
+
+	if (exemplar.pixels == 0 || output.pixels == 0)
+		return report;
+
+	auto covariance = [](const ImageStatistics& s, int i, int j) {
+		double n = (double)s.pixels;
+		return s.sumProducts[i][j] / n - (s.sum[i] / n) * (s.sum[j] / n);
+	};
+	for (int i = 0; i < 3; i++)
+	{
+		report.meanDifference[i] = (float)(output.sum[i] / output.pixels - exemplar.sum[i] / exemplar.pixels);
+		double variance = covariance(exemplar, i, i);
+		report.varianceRatio[i] = variance > 0.0 ? (float)(covariance(output, i, i) / variance) : 1.0f;
+		for (int j = i + 1; j < 3; j++)
+		{
+			double norm = std::sqrt(covariance(output, i, i) * covariance(output, j, j));
+			if (norm > 0.0)
+				report.maxCorrelation = std::max(report.maxCorrelation, (float)std::abs(covariance(output, i, j) / norm));
+		}
+	}
+
+	// radius 0 is the removed mean
+	if (exemplar.spectrumTile != output.spectrumTile || exemplar.spectrum.empty())
+		return report;
+	int bins = 0;
+	for (size_t r = 1; r < exemplar.spectrum.size(); r++)
+	{
+		if (exemplar.spectrumSamples[r] == 0 || output.spectrumSamples[r] == 0)
+			break;
+		double powerExemplar = exemplar.spectrum[r] / exemplar.spectrumSamples[r];
+		double powerOutput = output.spectrum[r] / output.spectrumSamples[r];
+		float ratio = powerExemplar > 0.0 ? (float)(powerOutput / powerExemplar) : 1.0f;
+		report.spectrumRatio.push_back(ratio);
+		report.spectrumError += std::abs(std::log10(std::max(ratio, 1e-6f)));
+		bins++;
+	}
+	if (bins > 0)
+		report.spectrumError /= bins;
+	return report;
+}
+
+void PrintQualityReport(std::ostream& out, const QualityReport& report)
+{
+	out << "Histogram W1 (r g b, x255): " << report.wasserstein.r * 255.0f << " "
+		<< report.wasserstein.g * 255.0f << " " << report.wasserstein.b * 255.0f << std::endl;
+	out << "Decorrelated mean shift: " << report.meanDifference.x << " " << report.meanDifference.y << " "
+		<< report.meanDifference.z << ", variance ratio: " << report.varianceRatio.x << " "
+		<< report.varianceRatio.y << " " << report.varianceRatio.z << ", max axis correlation: "
+		<< report.maxCorrelation << std::endl;
+	if (report.spectrumRatio.empty())
+		return;
+	out << "Spectrum error: " << report.spectrumError << " decades, output / exemplar power per octave:";
+	for (size_t radius = 1; radius <= report.spectrumRatio.size(); radius *= 2)
+		out << " " << report.spectrumRatio[radius - 1];
+	out << std::endl;
+}
+
+QualitySink::QualitySink(RowSink& output, const ExemplarPrecompute& basis, int spectrumTile, ThreadPool& pool)
+	: _output(output), _basis(basis), _pool(pool), _statistics(spectrumTile)
+{
+}
+
+void QualitySink::begin(int width, int height)
+{
+	_width = width;
+	_bufferedRows = 0;
+	_pending.clear();
+	_statistics = ImageStatistics(_statistics.spectrumTile);
+	int stripRows = _statistics.spectrumTile > 0 ? _statistics.spectrumTile : 64;
+	_strip = std::make_shared<std::vector<unsigned char>>((size_t)width * stripRows * 4);
+	_output.begin(width, height);
+}
+
+void QualitySink::write(const unsigned char* rgba, int rows)
+{
+	_output.write(rgba, rows);
+
+	size_t pitch = (size_t)_width * 4;
+	int stripRows = (int)(_strip->size() / pitch);
+	while (rows > 0)
+	{
+		int count = std::min(rows, stripRows - _bufferedRows);
+		memcpy(_strip->data() + _bufferedRows * pitch, rgba, count * pitch);
+		_bufferedRows += count;
+		rgba += count * pitch;
+		rows -= count;
+		if (_bufferedRows == stripRows)
+			flushStrip();
+	}
+}
+
+void QualitySink::finish()
+{
+	if (_bufferedRows > 0)
+		flushStrip();
+	while (!_pending.empty())
+	{
+		_statistics.merge(_pending.front().get());
+		_pending.pop_front();
+	}
+	_output.finish();
+}
+
+void QualitySink::flushStrip()
+{
+	// whole tiles per task, about two tasks per thread
+	int tile = std::max(1, _statistics.spectrumTile);
+	int chunk = std::max(tile, (_width / (int)(2 * _pool.size()) + tile - 1) / tile * tile);
+	std::shared_ptr<const std::vector<unsigned char>> strip = _strip;
+	int width = _width, rows = _bufferedRows, spectrumTile = _statistics.spectrumTile;
+	const ExemplarPrecompute& basis = _basis;
+	for (int x0 = 0; x0 < _width; x0 += chunk)
+	{
+		int x1 = std::min(_width, x0 + chunk);
+		_pending.push_back(_pool.submit([strip, width, rows, x0, x1, &basis, spectrumTile] {
+			ImageStatistics statistics(spectrumTile);
+			AccumulateStatistics(strip->data(), width, rows, x0, x1, basis, statistics);
+			return statistics;
+		}));
+	}
+
+	// a couple of strips in flight at most
+	while (_pending.size() > 4 * _pool.size())
+	{
+		_statistics.merge(_pending.front().get());
+		_pending.pop_front();
+	}
+	_strip = std::make_shared<std::vector<unsigned char>>(_strip->size());
+	_bufferedRows = 0;
+}
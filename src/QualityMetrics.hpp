@@ -0,0 +1,91 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <ostream>
+#include <vector>
+#include "Precompute.hpp"
+#include "StreamingBake.hpp"
+#include "../base/thread_pool.h"
+
+// Statistics telling whether a synthesized image matches its exemplar: the
+// RGB histograms, the moments in the PCA basis of DecorrelateColorSpace and the
+// radially averaged power spectrum. They are accumulated over strips of rows and
+// merged, so a bake is measured while it streams out.
+
+struct ImageStatistics
+{
+	std::array<std::array<uint64_t, 256>, 3> histogram{};
+	uint64_t pixels = 0;
+	// first and second moments of the decorrelated coordinates
+	double sum[3] = {};
+	double sumProducts[3][3] = {};
+	// power of the luminance per integer frequency radius, over spectrumTile^2 Hann windowed tiles
+	int spectrumTile = 0;
+	std::vector<double> spectrum;
+	std::vector<uint64_t> spectrumSamples;
+
+	explicit ImageStatistics(int spectrumTile = 0);
+
+	void merge(const ImageStatistics& other);
+};
+
+// 1D Wasserstein distance between two histograms, as a fraction of the value range
+float WassersteinDistance(const std::array<uint64_t, 256>& a, const std::array<uint64_t, 256>& b);
+
+// largest power of two tile, up to 128, that fits in the exemplar
+int ChooseSpectrumTile(int width, int height);
+
+// adds columns [x0, x1) of rows RGBA8 rows to statistics, the spectrum only
+// sees whole tiles of a strip exactly spectrumTile rows high
+void AccumulateStatistics(const unsigned char* rgba, int width, int rows, int x0, int x1,
+	const ExemplarPrecompute& basis, ImageStatistics& statistics);
+
+ImageStatistics ComputeStatistics(const TextureDataFloat& image, const ExemplarPrecompute& basis,
+	int spectrumTile, ThreadPool& pool);
+
+struct QualityReport
+{
+	// per RGB channel, in [0, 1]
+	glm::vec3 wasserstein = glm::vec3(0.0f);
+	// along the decorrelated axes, output minus exemplar and output over exemplar
+	glm::vec3 meanDifference = glm::vec3(0.0f);
+	glm::vec3 varianceRatio = glm::vec3(1.0f);
+	// largest correlation between two decorrelated axes of the output, 0 for the exemplar
+	float maxCorrelation = 0.0f;
+	// mean |log10| of the output over exemplar power, per radius
+	float spectrumError = 0.0f;
+	std::vector<float> spectrumRatio;
+};
+
+QualityReport CompareStatistics(const ImageStatistics& exemplar, const ImageStatistics& output);
+
+void PrintQualityReport(std::ostream& out, const QualityReport& report);
+
+// Measures the rows on their way to another sink. Strips of spectrumTile rows
+// are analysed on the pool while the bake goes on, finish() waits for them.
+class QualitySink : public RowSink
+{
+public:
+	QualitySink(RowSink& output, const ExemplarPrecompute& basis, int spectrumTile, ThreadPool& pool);
+
+	void begin(int width, int height) override;
+	void write(const unsigned char* rgba, int rows) override;
+	void finish() override;
+
+	const ImageStatistics& statistics() const { return _statistics; }
+
+private:
+	RowSink& _output;
+	const ExemplarPrecompute& _basis;
+	ThreadPool& _pool;
+	int _width = 0;
+	int _bufferedRows = 0;
+	std::shared_ptr<std::vector<unsigned char>> _strip;
+	std::deque<std::future<ImageStatistics>> _pending;
+	ImageStatistics _statistics;
+
+	void flushStrip();
+};
@@ -50,6 +50,16 @@ public:
         glBindVertexArray(0);
     }
 
+    // draws the quad once per instance, instances position themselves from gl_InstanceID
+    void renderQuadInstanced(int instanceCount)
+    {
+        if (quadVAO == 0)
+            renderQuad();
+        glBindVertexArray(quadVAO);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instanceCount);
+        glBindVertexArray(0);
+    }
+
     void operator()()
     {
         renderQuad();
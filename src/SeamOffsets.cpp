@@ -0,0 +1,91 @@
+#include "SeamOffsets.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	float ColorDifference(glm::vec3 a, glm::vec3 b)
+	{
+		glm::vec3 d = glm::abs(a - b);
+		return d.x + d.y + d.z;
+	}
+
+	// mean of values over [begin, end) texels, wrapping around
+	float WrappedMean(const std::vector<double>& prefix, double begin, double end)
+	{
+		int size = (int)prefix.size() - 1;
+		int first = (int)std::floor(begin), last = (int)std::ceil(end);
+		double sum = 0.0;
+		for (int i = first; i < last; )
+		{
+			int wrapped = ((i % size) + size) % size;
+			int run = std::min(last - i, size - wrapped);
+			sum += prefix[wrapped + run] - prefix[wrapped];
+			i += run;
+		}
+		return (float)(sum / std::max(1, last - first));
+	}
+}
+
+std::shared_ptr<const SeamOffsetTable> BuildSeamOffsetTable(const TextureDataFloat& source)
+{
+	int width = source.width, height = source.height;
+	if (width < 2 || height < 2)
+		return nullptr;
+
+	// mean difference of neighbouring texels along each axis
+	double stepX = 0.0, stepY = 0.0;
+	for (int y = 0; y < height; y++)
+	for (int x = 0; x < width; x++)
+	{
+		glm::vec3 color = source.GetColorAt(x, y);
+		if (x + 1 < width)
+			stepX += ColorDifference(color, source.GetColorAt(x + 1, y));
+		if (y + 1 < height)
+			stepY += ColorDifference(color, source.GetColorAt(x, y + 1));
+	}
+	stepX = std::max(stepX / ((double)(width - 1) * height), 1e-6);
+	stepY = std::max(stepY / ((double)width * (height - 1)), 1e-6);
+
+	// contrast of the border per row (u = 0) and per column (v = 0), as prefix sums
+	std::vector<double> seamX(height + 1, 0.0), seamY(width + 1, 0.0);
+	for (int y = 0; y < height; y++)
+		seamX[y + 1] = seamX[y] + ColorDifference(source.GetColorAt(width - 1, y), source.GetColorAt(0, y)) / stepX;
+	for (int x = 0; x < width; x++)
+		seamY[x + 1] = seamY[x] + ColorDifference(source.GetColorAt(x, height - 1), source.GetColorAt(x, 0)) / stepY;
+
+	auto table = std::make_shared<SeamOffsetTable>();
+	table->seamContrast = glm::vec2((float)(seamX[height] / height), (float)(seamY[width] / width));
+
+	// window of the centers of a cell: one grid edge around it
+	const float radius = 1.0f / 3.464f;
+	const float cellSize = 1.0f / SEAM_OFFSET_GRID;
+	std::vector<glm::vec2> good;
+	for (int j = 0; j < SEAM_OFFSET_GRID; j++)
+	for (int i = 0; i < SEAM_OFFSET_GRID; i++)
+	{
+		float u0 = i * cellSize - radius, u1 = (i + 1) * cellSize + radius;
+		float v0 = j * cellSize - radius, v1 = (j + 1) * cellSize + radius;
+		bool crossesU = u0 < 0.0f || u1 > 1.0f;
+		bool crossesV = v0 < 0.0f || v1 > 1.0f;
+		// only the part of the border inside the window counts
+		float contrastU = crossesU ? WrappedMean(seamX, v0 * height, v1 * height) : 0.0f;
+		float contrastV = crossesV ? WrappedMean(seamY, u0 * width, u1 * width) : 0.0f;
+		if (std::max(contrastU, contrastV) <= SEAM_CONTRAST_THRESHOLD)
+			good.push_back(glm::vec2(i * cellSize, j * cellSize));
+	}
+
+	// nothing to avoid, or nowhere to go
+	if (good.size() == SEAM_OFFSET_ENTRIES || good.empty())
+		return nullptr;
+
+	table->goodFraction = (float)good.size() / SEAM_OFFSET_ENTRIES;
+	table->cells = TextureDataFloat(SEAM_OFFSET_ENTRIES, 1, 3);
+	for (int entry = 0; entry < SEAM_OFFSET_ENTRIES; entry++)
+	{
+		glm::vec2 cell = good[(size_t)entry * good.size() / SEAM_OFFSET_ENTRIES];
+		table->cells.SetColorAt(entry, 0, glm::vec3(cell, 0.0f));
+	}
+	return table;
+}
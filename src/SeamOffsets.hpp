@@ -0,0 +1,50 @@
+#pragma once
+#include <memory>
+#include <glm/glm.hpp>
+#include "TextureDataFloat.hpp"
+
+// Vertex offsets that keep away from the seams of non-tileable exemplars.
+// A vertex samples the exemplar over a window the size of its hexagon (one
+// grid edge around uv + offset), so with GL_REPEAT a window across the border
+// of an exemplar that does not tile shows a straight seam. The window centers
+// are cut into a grid of cells, the cells whose window crosses a visible
+// seam are dropped and the hashed offset is remapped so that the window is
+// centered in one of the remaining cells.
+
+// cells per side and entries of the table, every good cell fits in it
+#define SEAM_OFFSET_GRID 32
+#define SEAM_OFFSET_ENTRIES (SEAM_OFFSET_GRID * SEAM_OFFSET_GRID)
+
+// a border is a seam where it differs this much more than neighbouring texels
+#define SEAM_CONTRAST_THRESHOLD 2.0f
+
+struct SeamOffsetTable
+{
+	// SEAM_OFFSET_ENTRIES x 1, lower corner of a good cell in rg, good cells equally often
+	TextureDataFloat cells;
+	// border difference over the mean difference of neighbouring texels,
+	// across u = 0 (x) and v = 0 (y), averaged along the border
+	glm::vec2 seamContrast = glm::vec2(1.0f);
+	// fraction of the window centers that are kept
+	float goodFraction = 1.0f;
+};
+
+// table of an exemplar, bottom row first like SynthExemplar; null when it
+// tiles and the plain hash can be kept
+std::shared_ptr<const SeamOffsetTable> BuildSeamOffsetTable(const TextureDataFloat& source);
+
+// uv of a grid vertex relative to the grid origin, inverse of the skew in TriangleGrid
+inline glm::vec2 VertexUV(glm::ivec2 vertex, glm::ivec2 originVertex, glm::vec2 originFraction)
+{
+	glm::vec2 skewed = glm::vec2(vertex - originVertex) - originFraction;
+	return glm::vec2(skewed.x + 0.5f * skewed.y, 0.8660254f * skewed.y) / 3.464f;
+}
+
+// offset of a vertex with hash h, same as vertexOffset() in synth_common.glsl
+inline glm::vec2 SeamAwareOffset(const SeamOffsetTable& table, glm::vec2 h, glm::vec2 vertexUV)
+{
+	float entry = h.x * (float)SEAM_OFFSET_ENTRIES;
+	int index = (int)entry;
+	glm::vec2 cell(table.cells.GetPixel(index, 0, 0), table.cells.GetPixel(index, 0, 1));
+	return cell + glm::vec2(entry - std::floor(entry), h.y) * (1.0f / SEAM_OFFSET_GRID) - vertexUV;
+}
@@ -1,7 +1,14 @@
 #pragma once
 #include "NoiseSynth.hpp"
 #include "Precompute.hpp"
-NoiseSynth::NoiseSynth(const std::string &basedir)
+#include "LUTParameters.hpp"
+#include "ExemplarFile.hpp"
+#include "InverseLUT3D.hpp"
+#include "ExemplarPyramid.hpp"
+#include "SynthCPU.hpp"
+#include <cstring>
+#include <thread>
+NoiseSynth::NoiseSynth(const std::string &basedir, bool headless) : Application(!headless)
 {   
  
 #ifdef DEBUG
@@ -21,41 +28,25 @@ NoiseSynth::NoiseSynth(const std::string &basedir)
     _synthShader->setInt("src_texture",0);
     _synthShader->setInt("gauss_texture",1);
     _synthShader->setInt("inv_lut_texture",2);
+    _synthShader->setInt("inv_lut3d_texture",3);
+    _synthShader->setInt("band_gauss_texture",4);
+    _synthShader->setInt("band_lut_texture",5);
+    _synthShader->setInt("seam_offset_texture",6);
+    _synthShader->setInt("vertex_offset_texture",7);
 
-    TextureDataFloat _noiseTextureData;
-    if(TextureDataFloat::LoadTextureFromPNG(noiseTexturePath.c_str(),_noiseTextureData))
-        return;
-    
-    // note that to perform an approximate OT through histogram normalization
-    // a decorrelation step is required (i.e. PCA)
-    TextureDataFloat input_decorrelated = TextureDataFloat(_noiseTextureData.width, _noiseTextureData.height, 3);
-
-	DecorrelateColorSpace(_noiseTextureData, 
-							input_decorrelated, 
-							this->colorSpaceVec1, 
-							this->colorSpaceVec2, 
-							this->colorSpaceVec3, 
-							this->colorSpaceOrigin);
-
-    _synthShader->use();
-    _synthShader->setVec3("_colorSpaceVec1",this->colorSpaceVec1);
-    _synthShader->setVec3("_colorSpaceVec2",this->colorSpaceVec2);
-    _synthShader->setVec3("_colorSpaceVec3",this->colorSpaceVec3);
-    _synthShader->setVec3("_colorSpaceOrigin",this->colorSpaceOrigin);
-    
-    //calculating inverse transformation
-    const int LUT_WIDTH = 128;
-    auto Tinv = TextureDataFloat(LUT_WIDTH, 1, 3);
-    for(int channel = 0 ; channel < 3 ; channel++)
-	{
-		ComputeinvT(input_decorrelated, Tinv, channel);
-	}
+    // compute path is optional, e.g. macOS stops at 4.1
+    if(ComputeSynth::isSupported())
+    {
+        _computeSynth.reset(new ComputeSynth(synthCompCode));
+        _computeVolumeSynth.reset(new ComputeVolumeSynth(synth3dCompCode));
+    }
 
-    _invLutTexture.reset(new Texture2D());
-    _noiseTexture.reset(new Texture2D(noiseTexturePath));
-    _gaussianTexture.reset(new Texture2D(gaussianTexturePath));
-
-    CreateGLTextureFromTextureDataStruct(*_invLutTexture.get(), Tinv, GL_CLAMP_TO_EDGE, false);
+    // the exemplar is decoded and precomputed on worker threads so the window
+    // comes up right away, updateExemplar() finishes the job on the GL thread
+    _loader.reset(new TextureLoader());
+    strncpy(noisePathBuffer, noiseTexturePath.c_str(), sizeof(noisePathBuffer) - 1);
+    strncpy(gaussianPathBuffer, gaussianTexturePath.c_str(), sizeof(gaussianPathBuffer) - 1);
+    requestExemplar(noiseTexturePath, gaussianTexturePath);
 
     // init imgui
     IMGUI_CHECKVERSION();
@@ -72,3 +63,475 @@ NoiseSynth::~NoiseSynth()
     ImGui::DestroyContext();
 }
 
+
+
+// starts loading an exemplar in the background, it replaces the current one
+// once its textures and precomputation are all ready
+void NoiseSynth::requestExemplar(const std::string& noisePath, const std::string& gaussianPath)
+{
+    _noisePath = noisePath;
+    _gaussianPath = gaussianPath;
+    _noiseWriteTime = std::filesystem::file_time_type();
+    _gaussianWriteTime = std::filesystem::file_time_type();
+
+    // a newer request supersedes the pending one, its callbacks become no-ops
+    int generation = ++_exemplarGeneration;
+    _pendingExemplar.reset(new PendingExemplar());
+    _pendingExemplar->generation = generation;
+    _pendingExemplar->noisePath = noisePath;
+    _pendingExemplar->gaussianPath = gaussianPath;
+    _pendingExemplar->noise = std::make_shared<Texture2D>();
+    _pendingExemplar->gaussian = std::make_shared<Texture2D>();
+
+    // precomputed exemplar, the gaussian and the LUT are in the same file
+    if(IsExemplarFile(noisePath))
+    {
+        auto file = _loader->pool().submit([noisePath]() { return OpenExemplarFile(noisePath); }).share();
+        _pendingExemplar->file = file;
+        _pendingExemplar->precompute = _loader->pool().submit([file]() {
+            return std::make_shared<ExemplarPrecompute>(file.get()->precompute);
+        });
+        _pendingExemplar->seamOffsets = _loader->pool().submit([file]() {
+            return BuildSeamOffsetTable(file.get()->source);
+        });
+        return;
+    }
+
+    // files may have changed on disk since the last decode
+    _loader->invalidate(noisePath);
+    _loader->invalidate(gaussianPath);
+
+    auto onUploaded = [this, generation](bool success) {
+        if(!_pendingExemplar || _pendingExemplar->generation != generation)
+            return;
+        _pendingExemplar->uploads++;
+        _pendingExemplar->failed |= !success;
+    };
+    _loader->upload(noisePath, _pendingExemplar->noise, onUploaded);
+    _loader->upload(gaussianPath, _pendingExemplar->gaussian, onUploaded);
+
+    // the decoded noise image is shared by the upload and the precomputation
+    TextureLoader::DecodeFuture noiseImage = _loader->decode(noisePath);
+    _pendingExemplar->precompute = _loader->pool().submit([noiseImage, noisePath]() {
+        TextureDataFloat noiseTextureData;
+        TextureDataFloat::FromDecodedImage(*noiseImage.get(), noiseTextureData);
+
+        auto precompute = std::make_shared<ExemplarPrecompute>();
+        PrecomputeExemplar(noisePath, noiseTextureData, *precompute);
+        return precompute;
+    });
+    // in uv, bottom row first like the texture
+    _pendingExemplar->seamOffsets = _loader->pool().submit([noiseImage]() {
+        TextureDataFloat source;
+        TextureDataFloat::FromDecodedImage(*noiseImage.get(), source);
+        FlipVertically(source);
+        return BuildSeamOffsetTable(source);
+    });
+}
+
+// sets the products of the precomputation on the GPU side
+void NoiseSynth::applyPrecompute(const ExemplarPrecompute& precompute)
+{
+    this->colorSpaceVec1 = precompute.colorSpaceVec1;
+    this->colorSpaceVec2 = precompute.colorSpaceVec2;
+    this->colorSpaceVec3 = precompute.colorSpaceVec3;
+    this->colorSpaceOrigin = precompute.colorSpaceOrigin;
+    _exemplarWidth = precompute.width;
+    _exemplarHeight = precompute.height;
+
+    setColorSpace(*_synthShader);
+    if(_computeSynth)
+    {
+        setColorSpace(_computeSynth->shader());
+        setColorSpace(_computeVolumeSynth->shader());
+    }
+    if(_meshShader)
+        setColorSpace(*_meshShader);
+
+    _invLutTexture.reset(new Texture2D());
+    CreateGLTextureFromTextureDataStruct(*_invLutTexture.get(), precompute.Tinv, GL_CLAMP_TO_EDGE, false, GL_RGB16F);
+}
+
+void NoiseSynth::setColorSpace(Shader& shader)
+{
+    shader.use();
+    shader.setVec3("_colorSpaceVec1",this->colorSpaceVec1);
+    shader.setVec3("_colorSpaceVec2",this->colorSpaceVec2);
+    shader.setVec3("_colorSpaceVec3",this->colorSpaceVec3);
+    shader.setVec3("_colorSpaceOrigin",this->colorSpaceOrigin);
+}
+
+void NoiseSynth::setSynthOptions(const SynthOptions& options)
+{
+    seamAware = options.seamAware;
+    offsetTable = options.offsetTable;
+    offsetTableLog2 = 0;
+    while((1 << offsetTableLog2) < options.vertexOffsets.size && offsetTableLog2 < 30)
+        offsetTableLog2++;
+    offsetRotation = options.vertexOffsets.rotation;
+    offsetScale = options.vertexOffsets.scale;
+}
+
+// pyramid bands [firstBand, size) and their colour spaces for blendMode 7 of synth.fs and synth.comp
+void NoiseSynth::bindPyramid(Shader& shader, int firstBand, GLenum gaussianUnit, GLenum lutUnit)
+{
+    shader.setInt("bandCount",_pyramid->size());
+    shader.setInt("firstBand",firstBand);
+    shader.setVec3("bandMean",_pyramid->mean());
+    shader.setVec3("bandGain",_pyramid->gain());
+    for(int k = firstBand; k < _pyramid->size(); k++)
+    {
+        const ExemplarPrecompute& precompute = _pyramid->band(k).precompute;
+        std::string index = "[" + std::to_string(k) + "]";
+        shader.setVec3("bandVec1" + index, precompute.colorSpaceVec1);
+        shader.setVec3("bandVec2" + index, precompute.colorSpaceVec2);
+        shader.setVec3("bandVec3" + index, precompute.colorSpaceVec3);
+        shader.setVec3("bandOrigin" + index, precompute.colorSpaceOrigin);
+    }
+    glActiveTexture(gaussianUnit);
+    _bandGaussianTexture->bind();
+    glActiveTexture(lutUnit);
+    _bandLutTexture->bind();
+}
+
+// vertex offset parameters of the GUI, seeded with the Hash Seed
+VertexOffsetParameters NoiseSynth::vertexOffsetParameters() const
+{
+    VertexOffsetParameters parameters;
+    parameters.size = 1 << offsetTableLog2;
+    parameters.rotation = offsetRotation;
+    parameters.scale = offsetScale;
+    parameters.seed = (uint32_t)hashSeed;
+    return parameters;
+}
+
+// builds the vertex offset table on a worker when its parameters changed and
+// uploads it once it is done, null while the hash is used. Until then the
+// previous table (of other parameters) stays in use.
+std::shared_ptr<const VertexOffsetTable> NoiseSynth::updateVertexOffsets()
+{
+    if(_pendingVertexOffsets.valid() && _pendingVertexOffsets.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        try
+        {
+            _vertexOffsets = _pendingVertexOffsets.get();
+            _vertexOffsetTexture.reset(new Texture2D());
+            CreateGLTextureFromTextureDataStruct(*_vertexOffsetTexture, _vertexOffsets->texels, GL_REPEAT, false, GL_RGBA32F);
+        }
+        catch(const std::exception& e)
+        {
+            std::cerr << "Couldn't build the vertex offset table: " << e.what() << std::endl;
+        }
+    }
+    if(!offsetTable)
+        return nullptr;
+
+    // one build per parameter set, a failed one is not retried
+    VertexOffsetParameters parameters = vertexOffsetParameters();
+    bool current = _vertexOffsets && _vertexOffsets->parameters == parameters;
+    bool requested = _vertexOffsetRequested && _vertexOffsetRequest == parameters;
+    if(!current && !requested && !_pendingVertexOffsets.valid())
+    {
+        _vertexOffsetRequested = true;
+        _vertexOffsetRequest = parameters;
+        _pendingVertexOffsets = _loader->pool().submit([parameters]() {
+            return BuildVertexOffsetTable(parameters);
+        });
+    }
+    return _vertexOffsets;
+}
+
+// blocks until the table of the current parameters is uploaded (or its build failed), for bakes and checks
+std::shared_ptr<const VertexOffsetTable> NoiseSynth::waitForVertexOffsets()
+{
+    std::shared_ptr<const VertexOffsetTable> table = updateVertexOffsets();
+    while(offsetTable && (!table || !(table->parameters == vertexOffsetParameters())) && _pendingVertexOffsets.valid())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        table = updateVertexOffsets();
+    }
+    return table;
+}
+
+void NoiseSynth::bindVertexOffsets(Shader& shader, GLenum unit)
+{
+    bool enabled = updateVertexOffsets() != nullptr;
+    shader.setInt("offsetTable", enabled ? 1 : 0);
+    if(enabled)
+    {
+        glActiveTexture(unit);
+        _vertexOffsetTexture->bind();
+    }
+}
+
+// seam-aware offsets for synth_common.glsl, on while the exemplar has seams and the GUI asks for them
+void NoiseSynth::bindSeamOffsets(Shader& shader, GLenum unit)
+{
+    bool enabled = seamAware && _seamOffsetTexture;
+    shader.setInt("seamAware", enabled ? 1 : 0);
+    if(enabled)
+    {
+        glActiveTexture(unit);
+        _seamOffsetTexture->bind();
+    }
+}
+
+// advances the pending exemplar and swaps it in as a whole once complete,
+// true as soon as an exemplar can be rendered
+bool NoiseSynth::updateExemplar()
+{
+    _loader->poll();
+
+    if(!_pendingExemplar)
+        return _exemplarReady;
+
+    auto& pending = *_pendingExemplar;
+    if(pending.file.valid() && pending.uploads < 2 &&
+       pending.file.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        // the mapped pixels go to the driver without an intermediate copy
+        try
+        {
+            std::shared_ptr<const ExemplarFile> file = pending.file.get();
+            const ExemplarFileHeader& header = file->header;
+            pending.noise->upload(header.width, header.height, 3, file->sourcePixels(), file->pixelType());
+            pending.gaussian->upload(header.width, header.height, 3, file->gaussianPixels(), file->pixelType());
+        }
+        catch(const std::exception&)
+        {
+            pending.failed = true;
+        }
+        pending.uploads = 2;
+    }
+    if(pending.uploads < 2 ||
+       pending.precompute.wait_for(std::chrono::seconds(0)) != std::future_status::ready ||
+       pending.seamOffsets.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return _exemplarReady;
+
+    try
+    {
+        std::shared_ptr<ExemplarPrecompute> precompute = pending.precompute.get();
+        std::shared_ptr<const SeamOffsetTable> seamOffsets = pending.seamOffsets.get();
+        if(pending.failed)
+            throw std::runtime_error("texture upload failed");
+
+        // everything is on the GPU, swap between two frames
+        applyPrecompute(*precompute);
+        _seamOffsetTexture.reset();
+        if(seamOffsets)
+        {
+            _seamOffsetTexture.reset(new Texture2D());
+            CreateGLTextureFromTextureDataStruct(*_seamOffsetTexture, seamOffsets->cells, GL_CLAMP_TO_EDGE, false, GL_RGB32F);
+        }
+        _noiseTexture = pending.noise;
+        _gaussianTexture = pending.gaussian;
+        _exemplarReady = true;
+        std::cout << "Loaded exemplar " << pending.noisePath << std::endl;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "Couldn't load exemplar " << pending.noisePath << ": " << e.what() << std::endl;
+    }
+
+    _pendingExemplar.reset();
+    return _exemplarReady;
+}
+
+// blocks until the pending exemplar is loaded, false if loading failed
+bool NoiseSynth::waitForExemplar()
+{
+    while(_pendingExemplar)
+    {
+        updateExemplar();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return _exemplarReady;
+}
+
+// builds the joint inverse LUT of the current exemplar on a worker, true once
+// a LUT of that exemplar is on the GPU (possibly of an older lut3DSize)
+bool NoiseSynth::updateLUT3D()
+{
+    if(_pendingLUT3D.valid() && _pendingLUT3D.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        try
+        {
+            std::shared_ptr<InverseLUT3D> lut = _pendingLUT3D.get();
+            if(_lut3DRequestGeneration == _exemplarGeneration)
+            {
+                _invLut3DTexture.reset(new Texture3D());
+                _invLut3DTexture->upload(lut->size, lut->size, lut->size, lut->rgb.data());
+                _lut3DTextureSize = lut->size;
+                _lut3DTextureGeneration = _lut3DRequestGeneration;
+            }
+        }
+        catch(const std::exception& e)
+        {
+            std::cerr << "Couldn't build the 3D LUT: " << e.what() << std::endl;
+        }
+    }
+
+    // one build per exemplar and size, a failed one is not retried
+    bool requested = _lut3DRequestGeneration == _exemplarGeneration && _lut3DRequestSize == lut3DSize;
+    if(_exemplarReady && !_pendingExemplar && !_pendingLUT3D.valid() && !requested)
+    {
+        _lut3DRequestGeneration = _exemplarGeneration;
+        _lut3DRequestSize = lut3DSize;
+        int size = lut3DSize;
+
+        // the pairs come from the full resolution exemplar and gaussian, as gaussianize.py matched them
+        std::function<void(TextureDataFloat&, TextureDataFloat&)> loadPairs;
+        if(IsExemplarFile(_noisePath))
+        {
+            std::string path = _noisePath;
+            loadPairs = [path](TextureDataFloat& source, TextureDataFloat& gaussian) {
+                std::shared_ptr<const ExemplarFile> file = OpenExemplarFile(path);
+                source = file->source;
+                gaussian = file->gaussian;
+            };
+        }
+        else
+        {
+            TextureLoader::DecodeFuture noiseImage = _loader->decode(_noisePath);
+            TextureLoader::DecodeFuture gaussianImage = _loader->decode(_gaussianPath);
+            loadPairs = [noiseImage, gaussianImage](TextureDataFloat& source, TextureDataFloat& gaussian) {
+                TextureDataFloat::FromDecodedImage(*noiseImage.get(), source);
+                TextureDataFloat::FromDecodedImage(*gaussianImage.get(), gaussian);
+            };
+        }
+
+        _pendingLUT3D = _loader->pool().submit([loadPairs, size]() {
+            TextureDataFloat source, gaussian;
+            loadPairs(source, gaussian);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            ThreadPool pool;
+            auto lut = std::make_shared<InverseLUT3D>(BuildInverseLUT3D(source, gaussian, size, pool));
+            std::cout << "Built the " << size << "^3 inverse LUT in "
+                      << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count()
+                      << " ms" << std::endl;
+            return lut;
+        });
+    }
+
+    return _invLut3DTexture && _lut3DTextureGeneration == _exemplarGeneration;
+}
+
+// Builds the pyramid bands [firstBand, size) of the current exemplar in the
+// background, coarsest first, and uploads them as they come in. Returns the
+// first band from which every band is on the GPU, -1 while there is none.
+int NoiseSynth::updatePyramid(int firstBand)
+{
+    if(_pendingPyramid.valid() && _pendingPyramid.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        try
+        {
+            std::shared_ptr<const ExemplarPyramid> pyramid = _pendingPyramid.get();
+            if(_pyramidRequestGeneration == _exemplarGeneration && pyramid != _pyramid)
+            {
+                _pyramid = pyramid;
+                _bandGaussianTexture.reset(new Texture2DArray());
+                _bandGaussianTexture->allocate(pyramid->width(), pyramid->height(), pyramid->size(), true);
+                _bandLutTexture.reset(new Texture2DArray());
+                _bandLutTexture->allocate(pyramid->lutWidth(), 1, pyramid->size(), false);
+                _uploadedBands = 0;
+                _pyramidGeneration = _pyramidRequestGeneration;
+            }
+        }
+        catch(const std::exception& e)
+        {
+            std::cerr << "Couldn't build the exemplar pyramid: " << e.what() << std::endl;
+        }
+    }
+
+    bool current = _pyramid && _pyramidGeneration == _exemplarGeneration;
+    int bands = current ? _pyramid->size() : MAX_PYRAMID_BANDS;
+    firstBand = std::max(0, std::min(firstBand, bands - 1));
+
+    // bands are only built once a view shows them, a failed build is not retried
+    bool requested = _pyramidRequestGeneration == _exemplarGeneration && _pyramidRequestBand <= firstBand;
+    if(_exemplarReady && !_pendingExemplar && !_pendingPyramid.valid() && !requested)
+    {
+        _pyramidRequestGeneration = _exemplarGeneration;
+        _pyramidRequestBand = firstBand;
+
+        std::function<std::shared_ptr<const ExemplarPyramid>()> loadPyramid;
+        if(current)
+        {
+            std::shared_ptr<const ExemplarPyramid> pyramid = _pyramid;
+            loadPyramid = [pyramid]() { return pyramid; };
+        }
+        else if(IsExemplarFile(_noisePath))
+        {
+            std::string path = _noisePath;
+            loadPyramid = [path]() {
+                return std::make_shared<const ExemplarPyramid>(OpenExemplarFile(path)->source);
+            };
+        }
+        else
+        {
+            // bottom row first, the way SynthCPU and the uploaded exemplar see it
+            TextureLoader::DecodeFuture noiseImage = _loader->decode(_noisePath);
+            loadPyramid = [noiseImage]() {
+                TextureDataFloat source;
+                TextureDataFloat::FromDecodedImage(*noiseImage.get(), source);
+                FlipVertically(source);
+                return std::make_shared<const ExemplarPyramid>(source);
+            };
+        }
+
+        _pendingPyramid = _loader->pool().submit([loadPyramid, firstBand]() {
+            std::shared_ptr<const ExemplarPyramid> pyramid = loadPyramid();
+            auto start = std::chrono::high_resolution_clock::now();
+            for(int k = pyramid->size() - 1; k >= std::min(firstBand, pyramid->size() - 1); k--)
+                pyramid->band(k);
+            std::cout << "Built the pyramid bands from " << firstBand << " in "
+                      << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count()
+                      << " ms" << std::endl;
+            return pyramid;
+        });
+    }
+
+    if(!current)
+        return -1;
+
+    int uploaded = -1;
+    for(int k = _pyramid->size() - 1; k >= 0 && _pyramid->built(k); k--)
+    {
+        if(!(_uploadedBands & (1u << k)))
+        {
+            const ExemplarBand& band = _pyramid->band(k);
+            _bandGaussianTexture->uploadLayer(k, band.gaussian[0].Pixels());
+            _bandLutTexture->uploadLayer(k, band.precompute.Tinv.Pixels());
+            _uploadedBands |= 1u << k;
+        }
+        uploaded = k;
+    }
+    return uploaded;
+}
+
+// reloads the exemplar when one of its files is rewritten
+void NoiseSynth::watchExemplarFiles()
+{
+    _watchTimer += _deltaTime;
+    if(_watchTimer < 0.5f)
+        return;
+    _watchTimer = 0.0f;
+
+    std::error_code error;
+    auto noiseTime = std::filesystem::last_write_time(_noisePath, error);
+    if(error)
+        return;
+    auto gaussianTime = std::filesystem::last_write_time(_gaussianPath, error);
+    if(error)
+        return;
+
+    if(noiseTime != _noiseWriteTime || gaussianTime != _gaussianWriteTime)
+    {
+        bool firstCheck = _noiseWriteTime == std::filesystem::file_time_type();
+        _noiseWriteTime = noiseTime;
+        _gaussianWriteTime = gaussianTime;
+        if(!firstCheck)
+            requestExemplar(_noisePath, _gaussianPath);
+    }
+}
@@ -0,0 +1,399 @@
+#include "StreamingBake.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+
+namespace
+{
+	uint32_t crc32(uint32_t crc, const unsigned char* data, size_t size)
+	{
+		static const std::array<uint32_t, 256> table = [] {
+			std::array<uint32_t, 256> t;
+			for (uint32_t n = 0; n < 256; n++)
+			{
+				uint32_t c = n;
+				for (int k = 0; k < 8; k++)
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				t[n] = c;
+			}
+			return t;
+		}();
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	void putBigEndian(std::vector<unsigned char>& out, uint32_t value)
+	{
+		out.push_back((unsigned char)(value >> 24));
+		out.push_back((unsigned char)(value >> 16));
+		out.push_back((unsigned char)(value >> 8));
+		out.push_back((unsigned char)value);
+	}
+
+	std::string extension(const std::string& filename)
+	{
+		size_t dot = filename.find_last_of('.');
+		std::string ext = dot == std::string::npos ? "" : filename.substr(dot + 1);
+		std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+		return ext;
+	}
+}
+
+RawTileSink::RawTileSink(const std::string& filename, int tileSize)
+	: _file(filename, std::ios::binary), _filename(filename), _tileSize(tileSize)
+{
+	if (!_file)
+		throw std::runtime_error("cannot open " + filename);
+}
+
+void RawTileSink::begin(int width, int height)
+{
+	_width = width;
+	_height = height;
+	_bufferedRows = 0;
+
+	RawTileHeader header;
+	header.width = width;
+	header.height = height;
+	header.tileSize = _tileSize;
+	_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	int tilesX = (width + _tileSize - 1) / _tileSize;
+	_band.assign((size_t)tilesX * _tileSize * _tileSize * 4, 0);
+	_tile.resize((size_t)_tileSize * _tileSize * 4);
+}
+
+void RawTileSink::write(const unsigned char* rgba, int rows)
+{
+	size_t pitch = (size_t)_width * 4;
+	while (rows > 0)
+	{
+		int count = std::min(rows, _tileSize - _bufferedRows);
+		for (int r = 0; r < count; r++)
+			std::memcpy(&_band[(size_t)(_bufferedRows + r) * _band.size() / _tileSize], rgba + r * pitch, pitch);
+		_bufferedRows += count;
+		rgba += count * pitch;
+		rows -= count;
+		if (_bufferedRows == _tileSize)
+			flushBand();
+	}
+}
+
+void RawTileSink::flushBand()
+{
+	// _band holds tileSize rows of tilesX * tileSize pixels, cut it into tiles
+	int tilesX = (int)(_band.size() / ((size_t)_tileSize * _tileSize * 4));
+	size_t bandPitch = _band.size() / _tileSize;
+	size_t tilePitch = (size_t)_tileSize * 4;
+	for (int tx = 0; tx < tilesX; tx++)
+	{
+		for (int r = 0; r < _tileSize; r++)
+			std::memcpy(&_tile[r * tilePitch], &_band[r * bandPitch + tx * tilePitch], tilePitch);
+		_file.write(reinterpret_cast<const char*>(_tile.data()), _tile.size());
+	}
+	std::fill(_band.begin(), _band.end(), 0);
+	_bufferedRows = 0;
+}
+
+void RawTileSink::finish()
+{
+	if (_bufferedRows > 0)
+		flushBand();
+	_file.close();
+	if (!_file)
+		throw std::runtime_error("failed to write " + _filename);
+}
+
+PngStreamSink::PngStreamSink(const std::string& filename)
+	: _file(filename, std::ios::binary), _filename(filename)
+{
+	if (!_file)
+		throw std::runtime_error("cannot open " + filename);
+}
+
+void PngStreamSink::writeChunk(const char type[4], const unsigned char* data, size_t size)
+{
+	std::vector<unsigned char> head;
+	putBigEndian(head, (uint32_t)size);
+	head.insert(head.end(), type, type + 4);
+	uint32_t crc = crc32(crc32(0, head.data() + 4, 4), data, size);
+
+	std::vector<unsigned char> tail;
+	putBigEndian(tail, crc);
+	_file.write(reinterpret_cast<const char*>(head.data()), head.size());
+	_file.write(reinterpret_cast<const char*>(data), size);
+	_file.write(reinterpret_cast<const char*>(tail.data()), tail.size());
+}
+
+void PngStreamSink::begin(int width, int height)
+{
+	_width = width;
+	_adlerA = 1;
+	_adlerB = 0;
+
+	static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+	_file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+	std::vector<unsigned char> ihdr;
+	putBigEndian(ihdr, width);
+	putBigEndian(ihdr, height);
+	ihdr.push_back(8); // bit depth
+	ihdr.push_back(6); // RGBA
+	ihdr.push_back(0); // deflate
+	ihdr.push_back(0); // adaptive filtering
+	ihdr.push_back(0); // no interlace
+	writeChunk("IHDR", ihdr.data(), ihdr.size());
+
+	// zlib header, no compression level hint
+	const unsigned char zlibHeader[2] = {0x78, 0x01};
+	writeChunk("IDAT", zlibHeader, 2);
+}
+
+void PngStreamSink::write(const unsigned char* rgba, int rows)
+{
+	// scanlines with filter type 0, cut into stored deflate blocks of at most 65535 bytes
+	size_t pitch = (size_t)_width * 4;
+	size_t rawSize = (pitch + 1) * rows;
+	_chunk.clear();
+	_chunk.reserve(rawSize + (rawSize / 65535 + 1) * 5);
+
+	size_t blockStart = 0, blockSize = 0;
+	auto put = [&](const unsigned char* data, size_t size) {
+		while (size > 0)
+		{
+			if (blockSize == 0)
+			{
+				blockStart = _chunk.size();
+				_chunk.insert(_chunk.end(), 5, 0);
+			}
+			size_t count = std::min(size, (size_t)65535 - blockSize);
+			_chunk.insert(_chunk.end(), data, data + count);
+
+			// Adler-32 of the uncompressed stream, reduced often enough not to overflow
+			for (size_t i = 0; i < count; i++)
+			{
+				_adlerA += data[i];
+				_adlerB += _adlerA;
+				if ((i & 4095) == 4095)
+				{
+					_adlerA %= 65521;
+					_adlerB %= 65521;
+				}
+			}
+			_adlerA %= 65521;
+			_adlerB %= 65521;
+
+			blockSize += count;
+			data += count;
+			size -= count;
+			uint16_t len = (uint16_t)blockSize;
+			_chunk[blockStart] = 0; // not final, stored
+			_chunk[blockStart + 1] = (unsigned char)len;
+			_chunk[blockStart + 2] = (unsigned char)(len >> 8);
+			_chunk[blockStart + 3] = (unsigned char)~len;
+			_chunk[blockStart + 4] = (unsigned char)(~len >> 8);
+			if (blockSize == 65535)
+				blockSize = 0;
+		}
+	};
+
+	const unsigned char filter = 0;
+	for (int r = 0; r < rows; r++)
+	{
+		put(&filter, 1);
+		put(rgba + r * pitch, pitch);
+	}
+	writeChunk("IDAT", _chunk.data(), _chunk.size());
+}
+
+void PngStreamSink::finish()
+{
+	// empty final stored block and the Adler-32 of the whole stream
+	std::vector<unsigned char> end = {1, 0, 0, 0xFF, 0xFF};
+	putBigEndian(end, (_adlerB << 16) | _adlerA);
+	writeChunk("IDAT", end.data(), end.size());
+	writeChunk("IEND", nullptr, 0);
+	_file.close();
+	if (!_file)
+		throw std::runtime_error("failed to write " + _filename);
+}
+
+DdsMipChainSink::DdsMipChainSink(const std::string& filename)
+	: _file(filename, std::ios::binary), _filename(filename)
+{
+	if (!_file)
+		throw std::runtime_error("cannot open " + filename);
+}
+
+void DdsMipChainSink::begin(int width, int height)
+{
+	// levels halve with floor like BuildMipChain, the last one is 1x1
+	_levels.clear();
+	uint64_t offset = 4 + 124;
+	for (int w = width, h = height;; w = std::max(1, w / 2), h = std::max(1, h / 2))
+	{
+		Level level;
+		level.width = w;
+		level.height = h;
+		level.offset = offset;
+		level.pending.resize((size_t)w * 4);
+		_levels.push_back(std::move(level));
+		offset += (uint64_t)w * h * 4;
+		if (w == 1 && h == 1)
+			break;
+	}
+
+	uint32_t header[32] = {};
+	header[0] = 0x20534444;	// "DDS "
+	header[1] = 124;		// dwSize
+	header[2] = 0x1 | 0x2 | 0x4 | 0x8 | 0x1000 | 0x20000; // CAPS, HEIGHT, WIDTH, PITCH, PIXELFORMAT, MIPMAPCOUNT
+	header[3] = height;
+	header[4] = width;
+	header[5] = width * 4;	// pitch
+	header[7] = (uint32_t)_levels.size();
+	header[19] = 32;		// pixel format size
+	header[20] = 0x40 | 0x1; // RGB, ALPHAPIXELS
+	header[22] = 32;		// bits per pixel
+	header[23] = 0x000000FF; // R
+	header[24] = 0x0000FF00; // G
+	header[25] = 0x00FF0000; // B
+	header[26] = 0xFF000000; // A
+	header[27] = 0x1000 | 0x400000 | 0x8; // TEXTURE, MIPMAP, COMPLEX
+	_file.write(reinterpret_cast<const char*>(header), sizeof(header));
+}
+
+void DdsMipChainSink::writeRow(int index, const unsigned char* rgba)
+{
+	Level& level = _levels[index];
+	if (level.rowsWritten >= level.height)
+		return; // odd height, the last row has no partner in the next level
+
+	_file.seekp((std::streamoff)(level.offset + (uint64_t)level.rowsWritten * level.width * 4));
+	_file.write(reinterpret_cast<const char*>(rgba), (std::streamsize)level.width * 4);
+	level.rowsWritten++;
+
+	if (index + 1 == (int)_levels.size())
+		return;
+
+	// rows pair up for the next level, a single row level is filtered with itself
+	const unsigned char* above = rgba;
+	if (level.hasPending)
+	{
+		above = level.pending.data();
+		level.hasPending = false;
+	}
+	else if (level.height > 1)
+	{
+		std::memcpy(level.pending.data(), rgba, level.pending.size());
+		level.hasPending = true;
+		return;
+	}
+
+	// 2x2 box, columns clamped like BuildMipChain
+	const Level& coarse = _levels[index + 1];
+	std::vector<unsigned char> row((size_t)coarse.width * 4);
+	for (int x = 0; x < coarse.width; x++)
+	{
+		int x0 = std::min(2 * x, level.width - 1), x1 = std::min(2 * x + 1, level.width - 1);
+		for (int c = 0; c < 4; c++)
+		{
+			int sum = above[x0 * 4 + c] + above[x1 * 4 + c] + rgba[x0 * 4 + c] + rgba[x1 * 4 + c];
+			row[x * 4 + c] = (unsigned char)((sum + 2) / 4);
+		}
+	}
+	writeRow(index + 1, row.data());
+}
+
+void DdsMipChainSink::write(const unsigned char* rgba, int rows)
+{
+	for (int r = 0; r < rows; r++)
+		writeRow(0, rgba + (size_t)r * _levels[0].width * 4);
+}
+
+void DdsMipChainSink::finish()
+{
+	for (const Level& level : _levels)
+		if (level.rowsWritten != level.height)
+			throw std::runtime_error("incomplete mip level in " + _filename);
+	_file.close();
+	if (!_file)
+		throw std::runtime_error("failed to write " + _filename);
+}
+
+std::unique_ptr<RowSink> CreateRowSink(const std::string& filename)
+{
+	std::string ext = extension(filename);
+	if (ext == "png")
+		return std::make_unique<PngStreamSink>(filename);
+	if (ext == "raw")
+		return std::make_unique<RawTileSink>(filename);
+	if (ext == "dds")
+		return std::make_unique<DdsMipChainSink>(filename);
+	throw std::runtime_error("unsupported streaming output " + filename + ", use .png, .raw or .dds");
+}
+
+StreamingBakeStats StreamingBake(const SynthExemplar& exemplar, int width, int height, glm::vec2 uvPerPixel,
+	int blendMode, uint32_t seed, RowSink& sink, ThreadPool& pool, int bandRows)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	size_t pitch = (size_t)width * 4;
+
+	// one task per row, row r from the top is uv row height - 1 - r
+	using Band = std::vector<std::future<void>>;
+	auto launch = [&](std::vector<unsigned char>& pixels, int firstRow, int rows) {
+		Band band;
+		for (int r = 0; r < rows; r++)
+		{
+			int y = height - 1 - (firstRow + r);
+			unsigned char* out = pixels.data() + r * pitch;
+			band.push_back(pool.submit([&exemplar, uvPerPixel, width, y, blendMode, seed, out] {
+				SynthesizeTile(exemplar, glm::dvec2(0.0, (double)y * uvPerPixel.y), uvPerPixel, width, 1,
+					blendMode, seed, out);
+			}));
+		}
+		return band;
+	};
+
+	// double buffered: the next band is synthesized while the sink writes this one
+	std::vector<unsigned char> buffers[2] = {std::vector<unsigned char>(pitch * bandRows),
+											 std::vector<unsigned char>(pitch * bandRows)};
+	sink.begin(width, height);
+	Band pending = launch(buffers[0], 0, std::min(bandRows, height));
+	for (int firstRow = 0, b = 0; firstRow < height; firstRow += bandRows, b ^= 1)
+	{
+		// every row of the band is done before a failed one rethrows, the others write into buffers[b]
+		for (auto& row : pending)
+			row.wait();
+		for (auto& row : pending)
+			row.get();
+
+		int rows = std::min(bandRows, height - firstRow);
+		int nextRow = firstRow + bandRows;
+		pending = nextRow < height ? launch(buffers[b ^ 1], nextRow, std::min(bandRows, height - nextRow)) : Band();
+		try
+		{
+			sink.write(buffers[b].data(), rows);
+		}
+		catch (...)
+		{
+			// the rows in flight still write into buffers
+			for (auto& row : pending)
+				row.wait();
+			throw;
+		}
+	}
+	sink.finish();
+
+	StreamingBakeStats stats;
+	stats.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	stats.megaPixelsPerSecond = (double)width * height / 1e6 / stats.seconds;
+	stats.bandBytes = pitch * bandRows;
+	return stats;
+}
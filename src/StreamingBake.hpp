@@ -0,0 +1,131 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "SynthCPU.hpp"
+#include "../base/thread_pool.h"
+
+// Offline synthesis of outputs far larger than memory: the image is produced
+// in bands of full rows, top row first, and handed to a sink that writes them
+// out right away. Memory is bounded by a couple of bands whatever the size.
+
+// Receives the image from the top row down
+class RowSink
+{
+public:
+	virtual ~RowSink() = default;
+
+	virtual void begin(int width, int height) = 0;
+
+	// rows * width RGBA8 pixels, top row first
+	virtual void write(const unsigned char* rgba, int rows) = 0;
+
+	virtual void finish() = 0;
+};
+
+// Tiled raw layout: a RawTileHeader, then the tiles in row-major order from the
+// top left, each tileSize^2 RGBA8 pixels top row first, edge tiles zero padded
+#define RAW_TILE_MAGIC 0x5452534Eu // "NSRT"
+
+struct RawTileHeader
+{
+	uint32_t magic = RAW_TILE_MAGIC;
+	uint32_t version = 1;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t tileSize = 0;
+	uint32_t channels = 4;
+};
+
+class RawTileSink : public RowSink
+{
+public:
+	RawTileSink(const std::string& filename, int tileSize = 256);
+
+	void begin(int width, int height) override;
+	void write(const unsigned char* rgba, int rows) override;
+	void finish() override;
+
+private:
+	std::ofstream _file;
+	std::string _filename;
+	int _tileSize;
+	int _width = 0;
+	int _height = 0;
+	int _bufferedRows = 0;
+	std::vector<unsigned char> _band; // one row of tiles
+	std::vector<unsigned char> _tile;
+
+	void flushBand();
+};
+
+// 8-bit RGBA PNG written one IDAT chunk per band. The zlib stream uses stored
+// (uncompressed) deflate blocks, so no compressor state has to be kept around.
+class PngStreamSink : public RowSink
+{
+public:
+	explicit PngStreamSink(const std::string& filename);
+
+	void begin(int width, int height) override;
+	void write(const unsigned char* rgba, int rows) override;
+	void finish() override;
+
+private:
+	std::ofstream _file;
+	std::string _filename;
+	int _width = 0;
+	uint32_t _adlerA = 1;
+	uint32_t _adlerB = 0;
+	std::vector<unsigned char> _chunk;
+
+	void writeChunk(const char type[4], const unsigned char* data, size_t size);
+};
+
+// RGBA8 DDS holding the full mip chain. Every level is box filtered from the
+// rows of the level above as they stream through, one pending row per level,
+// and written at its offset in the file, so the chain is done with level 0.
+class DdsMipChainSink : public RowSink
+{
+public:
+	explicit DdsMipChainSink(const std::string& filename);
+
+	void begin(int width, int height) override;
+	void write(const unsigned char* rgba, int rows) override;
+	void finish() override;
+
+	int levelCount() const { return (int)_levels.size(); }
+
+private:
+	struct Level
+	{
+		int width = 0;
+		int height = 0;
+		uint64_t offset = 0;
+		int rowsWritten = 0;
+		std::vector<unsigned char> pending; // even row waiting for its partner
+		bool hasPending = false;
+	};
+
+	std::ofstream _file;
+	std::string _filename;
+	std::vector<Level> _levels;
+
+	void writeRow(int level, const unsigned char* rgba);
+};
+
+// sink for filename by extension (.png, .raw or .dds), throws otherwise
+std::unique_ptr<RowSink> CreateRowSink(const std::string& filename);
+
+struct StreamingBakeStats
+{
+	double seconds = 0.0;
+	double megaPixelsPerSecond = 0.0;
+	size_t bandBytes = 0;
+};
+
+// synthesizes width x height pixels of uvPerPixel each, the lower left corner at
+// uv 0 like the GPU bake, bands are filled on pool while the previous one is written
+StreamingBakeStats StreamingBake(const SynthExemplar& exemplar, int width, int height, glm::vec2 uvPerPixel,
+	int blendMode, uint32_t seed, RowSink& sink, ThreadPool& pool, int bandRows = 64);
@@ -0,0 +1,100 @@
+#include "SynthAnimator.hpp"
+#include <future>
+
+SynthAnimator::SynthAnimator(std::shared_ptr<const SynthExemplar> exemplar, int width, int height, glm::vec2 uvPerPixel,
+	int blendMode, uint32_t seed)
+	: _exemplar(std::move(exemplar)), _width(width), _height(height), _uvPerPixel(uvPerPixel), _blendMode(blendMode),
+	  _seed(seed), _cache((size_t)width * height)
+{
+	_lod = ComputeLOD(*_exemplar, _uvPerPixel);
+}
+
+void SynthAnimator::frame(float time, unsigned char* rgba, ThreadPool& pool)
+{
+	_fetches = 0;
+	_reused = 0;
+
+	std::vector<std::future<void>> rows;
+	rows.reserve(_height);
+	for (int y = 0; y < _height; y++)
+		rows.push_back(pool.submit([this, y, time, rgba] {
+			uint64_t fetches = 0, reused = 0;
+			synthesizeRow(y, time, rgba + (size_t)y * _width * 4, fetches, reused);
+			_fetches += fetches;
+			_reused += reused;
+		}));
+	for (auto& row : rows)
+		row.get();
+
+	_cacheValid = true;
+}
+
+double SynthAnimator::reuseRatio() const
+{
+	uint64_t fetches = _fetches + _reused;
+	return fetches ? (double)_reused / fetches : 0.0;
+}
+
+void SynthAnimator::synthesizeRow(int y, float time, unsigned char* rgba, uint64_t& fetches, uint64_t& reused)
+{
+	const SynthExemplar& exemplar = *_exemplar;
+	// without OT, direct apply interpolation
+	bool source = _blendMode == 0 || _blendMode == 1 || _blendMode == 3;
+	const std::vector<TextureDataFloat>& chain = source ? exemplar.source : exemplar.gaussian;
+
+	for (int x = 0; x < _width; x++)
+	{
+		glm::vec2 uv((x + 0.5f) * _uvPerPixel.x, (y + 0.5f) * _uvPerPixel.y);
+		glm::vec3 color;
+
+		//source or gaussian picture
+		if (_blendMode == 3 || _blendMode == 4)
+			color = SampleTexture(chain, uv, _lod);
+		else
+		{
+			glm::vec4 w;
+			glm::ivec3 vertex[4];
+			TetrahedralGrid(glm::vec3(uv, time), w, vertex);
+
+			PixelVertices& cache = _cache[(size_t)y * _width + x];
+			PixelVertices next;
+			glm::vec3 G_upper(0.0f);
+			for (int i = 0; i < 4; i++)
+			{
+				next.vertex[i] = vertex[i];
+				int cached = -1;
+				for (int j = 0; _cacheValid && j < 4 && cached < 0; j++)
+					if (cache.vertex[j] == vertex[i])
+						cached = j;
+
+				if (cached >= 0)
+				{
+					next.G[i] = cache.G[cached];
+					reused++;
+				}
+				else
+				{
+					next.G[i] = SampleTexture(chain, uv + glm::vec2(HashOffset(Hash3(vertex[i], _seed))), _lod);
+					fetches++;
+				}
+				G_upper = G_upper + w[i] * next.G[i];
+			}
+			cache = next;
+
+			glm::vec3 G_cov = VariancePreservingBlend(G_upper, w);
+			if (_blendMode == 0)
+				color = G_upper;
+			else if (_blendMode == 1 || _blendMode == 5)
+				color = G_cov;
+			//inverse LUT
+			else
+				color = ReturnToOriginalColorSpace(exemplar.precompute, LookupLUT(exemplar.precompute.Tinv, G_cov, _lod));
+		}
+
+		color = glm::clamp(color, 0.0f, 1.0f);
+		*rgba++ = (unsigned char)std::lround(color.r * 255.0f);
+		*rgba++ = (unsigned char)std::lround(color.g * 255.0f);
+		*rgba++ = (unsigned char)std::lround(color.b * 255.0f);
+		*rgba++ = 255;
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "SynthCPU.hpp"
+#include "../base/thread_pool.h"
+
+// CPU frames of the animated noise, the space-time lattice synth.fs uses when
+// animate is set: every pixel blends the four vertices of its tetrahedron in
+// (u, v, t), each vertex being a random 2D offset of the exemplar. Between close
+// frames a pixel mostly keeps its vertices, so the gaussian values fetched for
+// the previous frame are kept per pixel (96 bytes) and only new vertices are
+// hashed and fetched again.
+class SynthAnimator
+{
+public:
+	SynthAnimator(std::shared_ptr<const SynthExemplar> exemplar, int width, int height, glm::vec2 uvPerPixel,
+		int blendMode = 2, uint32_t seed = 0);
+
+	int width() const { return _width; }
+
+	int height() const { return _height; }
+
+	// synthesizes the frame at time (lattice units) into width*height RGBA8 pixels, bottom row first
+	void frame(float time, unsigned char* rgba, ThreadPool& pool);
+
+	// fraction of the vertex fetches of the last frame served by the previous one
+	double reuseRatio() const;
+
+private:
+	struct PixelVertices
+	{
+		glm::ivec3 vertex[4];
+		glm::vec3 G[4];
+	};
+
+	void synthesizeRow(int y, float time, unsigned char* rgba, uint64_t& fetches, uint64_t& reused);
+
+	std::shared_ptr<const SynthExemplar> _exemplar;
+	int _width;
+	int _height;
+	glm::vec2 _uvPerPixel;
+	int _blendMode;
+	uint32_t _seed;
+	float _lod;
+	bool _cacheValid = false;
+	std::vector<PixelVertices> _cache;
+	std::atomic<uint64_t> _fetches{0};
+	std::atomic<uint64_t> _reused{0};
+};
@@ -0,0 +1,518 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "TextureDataFloat.hpp"
+#include "Precompute.hpp"
+#include "LUTParameters.hpp"
+#include "ExemplarFile.hpp"
+#include "InverseLUT3D.hpp"
+#include "SynthGrid.hpp"
+#include "ExemplarPyramid.hpp"
+#include "SeamOffsets.hpp"
+#include "VertexOffsets.hpp"
+
+// Scalar C++ version of the blend in synth.fs, for synthesis without a GL
+// context (tiles, offline bakes). Images are stored bottom row first and
+// sampled the way the GL textures are, so uv means the same on both sides.
+
+// Exemplar data needed by the CPU synthesis
+struct SynthExemplar
+{
+	// mip chains, level 0 first
+	std::vector<TextureDataFloat> source;
+	std::vector<TextureDataFloat> gaussian;
+	ExemplarPrecompute precompute;
+	// joint inverse transform for blendMode 6, built on demand
+	std::shared_ptr<const InverseLUT3D> lut3D;
+	// Laplacian pyramid for blendMode 7, built on demand
+	std::shared_ptr<const ExemplarPyramid> pyramid;
+	// offsets clear of the exemplar seams, null when it tiles
+	std::shared_ptr<const SeamOffsetTable> seamOffsets;
+	// precomputed per-vertex offsets replacing the hash, null for the hash
+	std::shared_ptr<const VertexOffsetTable> vertexOffsets;
+};
+
+// 2x2 box filtered mip chain down to 1x1
+inline std::vector<TextureDataFloat> BuildMipChain(TextureDataFloat level0)
+{
+	std::vector<TextureDataFloat> chain;
+	chain.push_back(std::move(level0));
+	while (chain.back().width > 1 || chain.back().height > 1)
+	{
+		const TextureDataFloat& fine = chain.back();
+		TextureDataFloat coarse(std::max(1, fine.width / 2), std::max(1, fine.height / 2), 3);
+		for (int y = 0; y < coarse.height; y++)
+		for (int x = 0; x < coarse.width; x++)
+		{
+			int x0 = std::min(2 * x, fine.width - 1), x1 = std::min(2 * x + 1, fine.width - 1);
+			int y0 = std::min(2 * y, fine.height - 1), y1 = std::min(2 * y + 1, fine.height - 1);
+			coarse.SetColorAt(x, y, 0.25f * (fine.GetColorAt(x0, y0) + fine.GetColorAt(x1, y0) +
+											 fine.GetColorAt(x0, y1) + fine.GetColorAt(x1, y1)));
+		}
+		chain.push_back(std::move(coarse));
+	}
+	return chain;
+}
+
+inline void FlipVertically(TextureDataFloat& image)
+{
+	size_t pitch = (size_t)image.width * image.channels;
+	for (int y = 0; y < image.height / 2; y++)
+		std::swap_ranges(image.data.begin() + y * pitch, image.data.begin() + (y + 1) * pitch,
+						 image.data.begin() + (image.height - 1 - y) * pitch);
+}
+
+// CPU side of the GUI switches that change the synthesized pixels, so the CPU
+// backends give the GPU result for the same settings
+struct SynthOptions
+{
+	bool seamAware = true; // "Seam-aware Offsets"
+	bool offsetTable = false; // "Precomputed Offsets"
+	VertexOffsetParameters vertexOffsets; // its table size, jitter and seed
+};
+
+// decodes and precomputes an exemplar (blocking)
+inline std::shared_ptr<SynthExemplar> LoadSynthExemplar(const std::string& noisePath, const std::string& gaussianPath,
+	const SynthOptions& options = SynthOptions())
+{
+	auto exemplar = std::make_shared<SynthExemplar>();
+
+	TextureDataFloat source, gaussian;
+	TextureDataFloat::FromDecodedImage(*DecodeImage(noisePath, 3), source);
+	TextureDataFloat::FromDecodedImage(*DecodeImage(gaussianPath, 3), gaussian);
+	PrecomputeExemplar(noisePath, source, exemplar->precompute);
+
+	FlipVertically(source);
+	FlipVertically(gaussian);
+	if (options.seamAware)
+		exemplar->seamOffsets = BuildSeamOffsetTable(source);
+	if (options.offsetTable)
+		exemplar->vertexOffsets = BuildVertexOffsetTable(options.vertexOffsets);
+	exemplar->source = BuildMipChain(std::move(source));
+	exemplar->gaussian = BuildMipChain(std::move(gaussian));
+	return exemplar;
+}
+
+// maps a .nsx exemplar, level 0 of both chains and the LUT stay in the mapping
+inline std::shared_ptr<SynthExemplar> LoadSynthExemplar(const std::string& exemplarPath, const SynthOptions& options = SynthOptions())
+{
+	std::shared_ptr<const ExemplarFile> file = OpenExemplarFile(exemplarPath);
+	auto exemplar = std::make_shared<SynthExemplar>();
+	exemplar->precompute = file->precompute;
+	if (options.seamAware)
+		exemplar->seamOffsets = BuildSeamOffsetTable(file->source);
+	if (options.offsetTable)
+		exemplar->vertexOffsets = BuildVertexOffsetTable(options.vertexOffsets);
+	exemplar->source = BuildMipChain(file->source);
+	exemplar->gaussian = BuildMipChain(file->gaussian);
+	return exemplar;
+}
+
+inline int WrapCoordinate(int x, int size)
+{
+	int r = x % size;
+	return r < 0 ? r + size : r;
+}
+
+// GL_LINEAR with GL_REPEAT
+inline glm::vec3 SampleBilinearRepeat(const TextureDataFloat& image, glm::vec2 uv)
+{
+	float x = uv.x * image.width - 0.5f;
+	float y = uv.y * image.height - 0.5f;
+	float fx = std::floor(x), fy = std::floor(y);
+	float tx = x - fx, ty = y - fy;
+	int x0 = WrapCoordinate((int)fx, image.width), x1 = WrapCoordinate((int)fx + 1, image.width);
+	int y0 = WrapCoordinate((int)fy, image.height), y1 = WrapCoordinate((int)fy + 1, image.height);
+	glm::vec3 bottom = glm::mix(image.GetColorAt(x0, y0), image.GetColorAt(x1, y0), tx);
+	glm::vec3 top = glm::mix(image.GetColorAt(x0, y1), image.GetColorAt(x1, y1), tx);
+	return glm::mix(bottom, top, ty);
+}
+
+// sampler state of Texture2D: linear magnification, GL_NEAREST_MIPMAP_NEAREST minification
+inline glm::vec3 SampleTexture(const std::vector<TextureDataFloat>& chain, glm::vec2 uv, float lod)
+{
+	if (lod <= 0.0f)
+		return SampleBilinearRepeat(chain[0], uv);
+
+	const TextureDataFloat& level = chain[std::min((int)std::lround(lod), (int)chain.size() - 1)];
+	int x = WrapCoordinate((int)std::floor(uv.x * level.width), level.width);
+	int y = WrapCoordinate((int)std::floor(uv.y * level.height), level.height);
+	return level.GetColorAt(x, y);
+}
+
+// level of detail of a pixel covering uvPerPixel, as textureQueryLod would return it
+inline float ComputeLOD(const SynthExemplar& exemplar, glm::vec2 uvPerPixel)
+{
+	float footprint = std::max(uvPerPixel.x * exemplar.gaussian[0].width, uvPerPixel.y * exemplar.gaussian[0].height);
+	return std::log2(std::max(footprint, 1e-8f));
+}
+
+// offset of a vertex in [0, 1), bit identical to hash() in the shaders
+inline glm::vec2 Hash(glm::ivec2 p, uint32_t seed)
+{
+	glm::uvec2 h = Pcg2d(glm::uvec2((uint32_t)p.x + seed * 0x9E3779B9u, (uint32_t)p.y + seed * 0x85EBCA6Bu));
+	return glm::vec2((float)(h.x >> 8), (float)(h.y >> 8)) * (1.0f / 16777216.0f);
+}
+
+// offset of a vertex, vertexOffset() in synth_common.glsl
+inline glm::vec2 VertexOffset(const SynthExemplar& exemplar, const GridOrigin& origin, glm::ivec2 vertex, uint32_t seed)
+{
+	glm::vec2 h = Hash(vertex, seed);
+	if (!exemplar.seamOffsets)
+		return h;
+	return SeamAwareOffset(*exemplar.seamOffsets, h, VertexUV(vertex, origin.vertex, origin.fraction));
+}
+
+// where a vertex samples the exemplar for the pixel at uv and at which lod, vertexSample() in synth_common.glsl
+inline glm::vec2 VertexSample(const SynthExemplar& exemplar, const GridOrigin& origin, glm::ivec2 vertex, uint32_t seed,
+	glm::vec2 uv, float& lod)
+{
+	if (!exemplar.vertexOffsets)
+		return uv + VertexOffset(exemplar, origin, vertex, seed);
+
+	glm::vec4 texel = FetchVertexOffset(*exemplar.vertexOffsets, vertex);
+	glm::vec2 center = VertexUV(vertex, origin.vertex, origin.fraction);
+	glm::vec2 offset(texel.x, texel.y);
+	if (exemplar.seamOffsets)
+		offset = SeamAwareOffset(*exemplar.seamOffsets, offset, center);
+
+	// the window is scaled by |(a, b)|, the derivatives and so the lod with it
+	glm::vec2 d = uv - center;
+	lod += std::log2(std::sqrt(texel.z * texel.z + texel.w * texel.w));
+	return center + offset + glm::vec2(texel.z * d.x - texel.w * d.y, texel.w * d.x + texel.z * d.y);
+}
+
+// Compute local triangle barycentric coordinates and vertex IDs, uv relative to origin
+inline void TriangleGrid(const GridOrigin& origin, glm::vec2 uv,
+	float& w1, float& w2, float& w3,
+	glm::ivec2& vertex1, glm::ivec2& vertex2, glm::ivec2& vertex3)
+{
+	// Scaling of the input
+	uv = uv * 3.464f; // 2 * sqrt(3)
+
+	// Skew input space into simplex triangle grid
+	glm::vec2 skewedCoord = glm::vec2(uv.x - 0.57735027f * uv.y, 1.15470054f * uv.y) + origin.fraction;
+
+	// Compute local triangle vertex IDs and local barycentric coordinates
+	glm::ivec2 baseId = origin.vertex + glm::ivec2((int)std::floor(skewedCoord.x), (int)std::floor(skewedCoord.y));
+	glm::vec3 temp(skewedCoord.x - std::floor(skewedCoord.x), skewedCoord.y - std::floor(skewedCoord.y), 0.0f);
+	temp.z = 1.0f - temp.x - temp.y;
+	if (temp.z > 0.0f)
+	{
+		w1 = temp.z;
+		w2 = temp.y;
+		w3 = temp.x;
+		vertex1 = baseId;
+		vertex2 = baseId + glm::ivec2(0, 1);
+		vertex3 = baseId + glm::ivec2(1, 0);
+	}
+	else
+	{
+		w1 = -temp.z;
+		w2 = 1.0f - temp.y;
+		w3 = 1.0f - temp.x;
+		vertex1 = baseId + glm::ivec2(1, 1);
+		vertex2 = baseId + glm::ivec2(1, 0);
+		vertex3 = baseId + glm::ivec2(0, 1);
+	}
+}
+
+inline glm::vec3 VariancePreservingBlend(glm::vec3 G_upper, float w1, float w2, float w3)
+{
+	glm::vec3 G_cov = (G_upper - glm::vec3(0.5f)) / std::sqrt(w1 * w1 + w2 * w2 + w3 * w3) + glm::vec3(0.5f);
+	return glm::clamp(G_cov, 0.0f, 1.0f);
+}
+
+// linear lookup in the LUT row selected by lod, like the compute shader
+inline glm::vec3 LookupLUT(const TextureDataFloat& lut, glm::vec3 G, float lod)
+{
+	int row = std::max(0, std::min((int)lod, lut.height - 1));
+	glm::vec3 color;
+	for (int channel = 0; channel < 3; channel++)
+	{
+		float x = std::max(0.0f, std::min(G[channel] * lut.width - 0.5f, (float)(lut.width - 1)));
+		int i0 = (int)std::floor(x);
+		int i1 = std::min(i0 + 1, lut.width - 1);
+		float t = x - i0;
+		color[channel] = lut.GetPixel(i0, row, channel) * (1.0f - t) + lut.GetPixel(i1, row, channel) * t;
+	}
+	return color;
+}
+
+inline glm::vec3 ReturnToOriginalColorSpace(const ExemplarPrecompute& precompute, glm::vec3 color)
+{
+	return precompute.colorSpaceOrigin +
+		precompute.colorSpaceVec1 * color.r +
+		precompute.colorSpaceVec2 * color.g +
+		precompute.colorSpaceVec3 * color.b;
+}
+
+// blendMode 7: every visible band blended on its own grid, 2^k times coarser
+// for band k, with its own offsets and inverse LUT, the bands summed back and
+// brought to the source contrast
+inline glm::vec3 SynthesizeMultiScale(const ExemplarPyramid& pyramid, const GridOrigin& origin, glm::vec2 uv, float lod,
+	uint32_t seed)
+{
+	glm::vec3 color(0.0f);
+	for (int k = FirstVisibleBand(lod, pyramid.size()); k < pyramid.size(); k++)
+	{
+		const ExemplarBand& band = pyramid.band(k);
+		double scale = 1.0 / (double)(1 << k);
+		GridOrigin bandOrigin = ComputeGridOrigin(origin.uvOrigin, scale);
+
+		float w1, w2, w3;
+		glm::ivec2 vertex1, vertex2, vertex3;
+		TriangleGrid(bandOrigin, uv * (float)scale, w1, w2, w3, vertex1, vertex2, vertex3);
+
+		uint32_t bandSeed = BandSeed(seed, k);
+		glm::vec3 G1 = SampleTexture(band.gaussian, uv + Hash(vertex1, bandSeed), lod);
+		glm::vec3 G2 = SampleTexture(band.gaussian, uv + Hash(vertex2, bandSeed), lod);
+		glm::vec3 G3 = SampleTexture(band.gaussian, uv + Hash(vertex3, bandSeed), lod);
+
+		glm::vec3 G_cov = VariancePreservingBlend(w1 * G1 + w2 * G2 + w3 * G3, w1, w2, w3);
+		color += ReturnToOriginalColorSpace(band.precompute, LookupLUT(band.precompute.Tinv, G_cov, lod));
+	}
+	return pyramid.mean() + pyramid.gain() * (color - pyramid.mean());
+}
+
+// one pixel of synth.fs for the given blendMode and hashSeed at origin + uv, lod from ComputeLOD
+inline glm::vec3 SynthesizePixel(const SynthExemplar& exemplar, const GridOrigin& origin, glm::vec2 uv, float lod,
+	int blendMode, uint32_t seed)
+{
+	//source picture
+	if (blendMode == 3)
+		return SampleTexture(exemplar.source, uv, lod);
+
+	//gaussian picture
+	if (blendMode == 4)
+		return SampleTexture(exemplar.gaussian, uv, lod);
+
+	//multi-scale, single scale inverse LUT until the pyramid exists
+	if (blendMode == 7 && exemplar.pyramid)
+		return SynthesizeMultiScale(*exemplar.pyramid, origin, uv, lod, seed);
+
+	float w1, w2, w3;
+	glm::ivec2 vertex1, vertex2, vertex3;
+	TriangleGrid(origin, uv, w1, w2, w3, vertex1, vertex2, vertex3);
+
+	// without OT, direct apply interpolation
+	const std::vector<TextureDataFloat>& input = (blendMode == 0 || blendMode == 1) ? exemplar.source : exemplar.gaussian;
+	float lod1 = lod, lod2 = lod, lod3 = lod;
+	glm::vec2 uv1 = VertexSample(exemplar, origin, vertex1, seed, uv, lod1);
+	glm::vec2 uv2 = VertexSample(exemplar, origin, vertex2, seed, uv, lod2);
+	glm::vec2 uv3 = VertexSample(exemplar, origin, vertex3, seed, uv, lod3);
+	glm::vec3 G1 = SampleTexture(input, uv1, lod1);
+	glm::vec3 G2 = SampleTexture(input, uv2, lod2);
+	glm::vec3 G3 = SampleTexture(input, uv3, lod3);
+
+	glm::vec3 G_upper = w1 * G1 + w2 * G2 + w3 * G3;
+	if (blendMode == 0)
+		return G_upper;
+
+	glm::vec3 G_cov = VariancePreservingBlend(G_upper, w1, w2, w3);
+	if (blendMode == 1 || blendMode == 5)
+		return G_cov;
+
+	//joint inverse LUT, straight to the original colour space
+	if (blendMode == 6 && exemplar.lut3D)
+		return LookupLUT3D(*exemplar.lut3D, G_cov);
+
+	//inverse LUT
+	return ReturnToOriginalColorSpace(exemplar.precompute, LookupLUT(exemplar.precompute.Tinv, G_cov, lod));
+}
+
+// RGBA8 block of width x height pixels, bottom row first, pixel centers at
+// origin + (x + 0.5, y + 0.5) * pixelUV. Positions are split into an integer
+// origin and a local uv in double, so far away tiles keep their precision.
+inline void SynthesizeTile(const SynthExemplar& exemplar, glm::dvec2 origin, glm::vec2 pixelUV,
+	int width, int height, int blendMode, uint32_t seed, unsigned char* rgba)
+{
+	float lod = ComputeLOD(exemplar, pixelUV);
+	glm::ivec2 cell(0);
+	GridOrigin gridOrigin;
+	for (int y = 0; y < height; y++)
+	for (int x = 0; x < width; x++)
+	{
+		double u = origin.x + (x + 0.5) * pixelUV.x;
+		double v = origin.y + (y + 0.5) * pixelUV.y;
+		glm::ivec2 pixelCell((int)std::floor(u), (int)std::floor(v));
+		if (pixelCell != cell || (x == 0 && y == 0))
+		{
+			cell = pixelCell;
+			gridOrigin = ComputeGridOrigin(cell);
+		}
+
+		glm::vec2 uv((float)(u - cell.x), (float)(v - cell.y));
+		glm::vec3 color = glm::clamp(SynthesizePixel(exemplar, gridOrigin, uv, lod, blendMode, seed), 0.0f, 1.0f);
+		*rgba++ = (unsigned char)std::lround(color.r * 255.0f);
+		*rgba++ = (unsigned char)std::lround(color.g * 255.0f);
+		*rgba++ = (unsigned char)std::lround(color.b * 255.0f);
+		*rgba++ = 255;
+	}
+}
+
+// PCG3D (Jarzynski & Olano 2020), same as pcg3d in synth_common.glsl
+inline glm::uvec3 Pcg3d(glm::uvec3 v)
+{
+	v = v * 1664525u + 1013904223u;
+	v.x += v.y * v.z;
+	v.y += v.z * v.x;
+	v.z += v.x * v.y;
+	v = v ^ (v >> 16u);
+	v.x += v.y * v.z;
+	v.y += v.z * v.x;
+	v.z += v.x * v.y;
+	return v;
+}
+
+// random bits of a tetrahedral grid vertex, hash3() in the shaders
+inline glm::uvec3 Hash3(glm::ivec3 p, uint32_t seed)
+{
+	return Pcg3d(glm::uvec3((uint32_t)p.x + seed * 0x9E3779B9u, (uint32_t)p.y + seed * 0x85EBCA6Bu,
+		(uint32_t)p.z + seed * 0xC2B2AE35u));
+}
+
+inline glm::vec3 HashOffset(glm::uvec3 h)
+{
+	return glm::vec3((float)(h.x >> 8), (float)(h.y >> 8), (float)(h.z >> 8)) * (1.0f / 16777216.0f);
+}
+
+// 3D version of TriangleGrid: the skewed cubic grid is cut into six tetrahedra
+// along its main diagonal (Kuhn), the sorted fractions give the barycentrics
+inline void TetrahedralGrid(glm::vec3 p, glm::vec4& w, glm::ivec3 vertex[4])
+{
+	// Scaling of the input, same density as the triangle grid
+	p = p * 3.464f;
+
+	// Skew input space into simplex grid
+	glm::vec3 skewedCoord = p + glm::vec3((p.x + p.y + p.z) * (1.0f / 3.0f));
+	glm::ivec3 baseId((int)std::floor(skewedCoord.x), (int)std::floor(skewedCoord.y), (int)std::floor(skewedCoord.z));
+	glm::vec3 f = skewedCoord - glm::vec3(baseId);
+
+	// Order the axes by decreasing fraction
+	int order[3];
+	if (f.x >= f.y)
+	{
+		if (f.y >= f.z)      { order[0] = 0; order[1] = 1; order[2] = 2; }
+		else if (f.x >= f.z) { order[0] = 0; order[1] = 2; order[2] = 1; }
+		else                 { order[0] = 2; order[1] = 0; order[2] = 1; }
+	}
+	else
+	{
+		if (f.y < f.z)       { order[0] = 2; order[1] = 1; order[2] = 0; }
+		else if (f.x < f.z)  { order[0] = 1; order[1] = 2; order[2] = 0; }
+		else                 { order[0] = 1; order[1] = 0; order[2] = 2; }
+	}
+
+	glm::vec3 sorted(f[order[0]], f[order[1]], f[order[2]]);
+	w = glm::vec4(1.0f - sorted.x, sorted.x - sorted.y, sorted.y - sorted.z, sorted.z);
+	vertex[0] = baseId;
+	vertex[1] = vertex[0];
+	vertex[1][order[0]] += 1;
+	vertex[2] = vertex[1];
+	vertex[2][order[1]] += 1;
+	vertex[3] = baseId + glm::ivec3(1);
+}
+
+// planar projection of a 3D position chosen per vertex, so 2D exemplars can fill a volume
+inline glm::vec2 ProjectVertex(glm::vec3 p, glm::uvec3 h)
+{
+	uint32_t axis = ((h.z >> 8) * 3u) >> 24;
+	glm::vec2 planar = axis == 0 ? glm::vec2(p.y, p.z) : (axis == 1 ? glm::vec2(p.x, p.z) : glm::vec2(p.x, p.y));
+	glm::vec3 offset = HashOffset(h);
+	return planar + glm::vec2(offset.x, offset.y);
+}
+
+inline glm::vec3 VariancePreservingBlend(glm::vec3 G_upper, glm::vec4 w)
+{
+	glm::vec3 G_cov = (G_upper - glm::vec3(0.5f)) / std::sqrt(glm::dot(w, w)) + glm::vec3(0.5f);
+	return glm::clamp(G_cov, 0.0f, 1.0f);
+}
+
+// tetrahedral blend of four fetches, fetch(p, source, vertex bits) returns the
+// exemplar value at p for a vertex from the source or the gaussian image,
+// vertex bits are null for the plain source / gaussian pictures
+template <class Fetch>
+inline glm::vec3 BlendTetrahedra(glm::vec3 p, int blendMode, uint32_t seed, const ExemplarPrecompute& precompute,
+	float lod, Fetch fetch)
+{
+	//source or gaussian picture
+	if (blendMode == 3 || blendMode == 4)
+		return fetch(p, blendMode == 3, nullptr);
+
+	glm::vec4 w;
+	glm::ivec3 vertex[4];
+	TetrahedralGrid(p, w, vertex);
+
+	// without OT, direct apply interpolation
+	bool source = blendMode == 0 || blendMode == 1;
+	glm::vec3 G_upper(0.0f);
+	for (int i = 0; i < 4; i++)
+	{
+		glm::uvec3 h = Hash3(vertex[i], seed);
+		G_upper = G_upper + w[i] * fetch(p, source, &h);
+	}
+	if (blendMode == 0)
+		return G_upper;
+
+	glm::vec3 G_cov = VariancePreservingBlend(G_upper, w);
+	if (blendMode == 1 || blendMode == 5)
+		return G_cov;
+
+	//inverse LUT
+	return ReturnToOriginalColorSpace(precompute, LookupLUT(precompute.Tinv, G_cov, lod));
+}
+
+// one voxel filled from a 2D exemplar through per-vertex planar projections
+inline glm::vec3 SynthesizeVoxel(const SynthExemplar& exemplar, glm::vec3 p, float lod, int blendMode, uint32_t seed)
+{
+	return BlendTetrahedra(p, blendMode, seed, exemplar.precompute, lod,
+		[&](glm::vec3 q, bool source, const glm::uvec3* h) {
+			glm::vec2 uv = h ? ProjectVertex(q, *h) : glm::vec2(q.x, q.y);
+			return SampleTexture(source ? exemplar.source : exemplar.gaussian, uv, lod);
+		});
+}
+
+// 3D exemplar: RGB voxels, x fastest, sampled with trilinear filtering and repeat
+struct VolumeExemplar
+{
+	int width = 0;
+	int height = 0;
+	int depth = 0;
+	std::vector<float> source;
+	std::vector<float> gaussian;
+	ExemplarPrecompute precompute;
+};
+
+inline glm::vec3 SampleTrilinearRepeat(const VolumeExemplar& volume, const std::vector<float>& voxels, glm::vec3 p)
+{
+	glm::vec3 x = p * glm::vec3((float)volume.width, (float)volume.height, (float)volume.depth) - glm::vec3(0.5f);
+	glm::vec3 f = glm::floor(x);
+	glm::vec3 t = x - f;
+	int x0 = WrapCoordinate((int)f.x, volume.width), x1 = WrapCoordinate((int)f.x + 1, volume.width);
+	int y0 = WrapCoordinate((int)f.y, volume.height), y1 = WrapCoordinate((int)f.y + 1, volume.height);
+	int z0 = WrapCoordinate((int)f.z, volume.depth), z1 = WrapCoordinate((int)f.z + 1, volume.depth);
+	auto at = [&](int i, int j, int k) {
+		const float* v = &voxels[(((size_t)k * volume.height + j) * volume.width + i) * 3];
+		return glm::vec3(v[0], v[1], v[2]);
+	};
+	glm::vec3 c00 = glm::mix(at(x0, y0, z0), at(x1, y0, z0), t.x);
+	glm::vec3 c10 = glm::mix(at(x0, y1, z0), at(x1, y1, z0), t.x);
+	glm::vec3 c01 = glm::mix(at(x0, y0, z1), at(x1, y0, z1), t.x);
+	glm::vec3 c11 = glm::mix(at(x0, y1, z1), at(x1, y1, z1), t.x);
+	return glm::mix(glm::mix(c00, c10, t.y), glm::mix(c01, c11, t.y), t.z);
+}
+
+// one voxel filled from a 3D exemplar, offsets are random 3D translations
+inline glm::vec3 SynthesizeVoxel(const VolumeExemplar& exemplar, glm::vec3 p, int blendMode, uint32_t seed)
+{
+	return BlendTetrahedra(p, blendMode, seed, exemplar.precompute, 0.0f,
+		[&](glm::vec3 q, bool source, const glm::uvec3* h) {
+			glm::vec3 offset = h ? HashOffset(*h) : glm::vec3(0.0f);
+			return SampleTrilinearRepeat(exemplar, source ? exemplar.source : exemplar.gaussian, q + offset);
+		});
+}
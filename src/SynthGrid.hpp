@@ -0,0 +1,45 @@
+#pragma once
+#include <cmath>
+#include <glm/glm.hpp>
+
+// Far from the origin a float uv cannot resolve the triangle grid any more, so
+// positions are split into an integer uv origin and a small local uv. Textures
+// repeat with period 1, sampling only needs the local part; the origin is
+// skewed here in double precision and split into the grid vertex it falls in
+// and the float remainder, which TriangleGrid adds to the skewed local uv.
+struct GridOrigin
+{
+	glm::ivec2 uvOrigin = glm::ivec2(0);
+	glm::ivec2 vertex = glm::ivec2(0);
+	glm::vec2 fraction = glm::vec2(0.0f);
+};
+
+// same constants as TriangleGrid, rounded to float like the shader literals,
+// scale is the uv scale of a coarser grid (the pyramid bands of blendMode 7)
+inline GridOrigin ComputeGridOrigin(glm::ivec2 uvOrigin, double scale = 1.0)
+{
+	double x = (double)3.464f * uvOrigin.x * scale;
+	double y = (double)3.464f * uvOrigin.y * scale;
+	double skewedX = x - (double)0.57735027f * y;
+	double skewedY = (double)1.15470054f * y;
+
+	GridOrigin origin;
+	origin.uvOrigin = uvOrigin;
+	double floorX = std::floor(skewedX), floorY = std::floor(skewedY);
+	origin.vertex = glm::ivec2((int)floorX, (int)floorY);
+	origin.fraction = glm::vec2((float)(skewedX - floorX), (float)(skewedY - floorY));
+	return origin;
+}
+
+// PCG2D (Jarzynski & Olano 2020), same as pcg2d in synth_common.glsl
+inline glm::uvec2 Pcg2d(glm::uvec2 v)
+{
+	v = v * 1664525u + 1013904223u;
+	v.x += v.y * 1664525u;
+	v.y += v.x * 1664525u;
+	v = v ^ (v >> 16u);
+	v.x += v.y * 1664525u;
+	v.y += v.x * 1664525u;
+	v = v ^ (v >> 16u);
+	return v;
+}
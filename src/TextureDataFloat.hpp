@@ -1,5 +1,8 @@
 #pragma once
+#include <algorithm>
+#include <cmath>
 #include <glm/glm.hpp>
+#include <memory>
 #include <vector>
 #include <iostream>
 #include "../external/stb/stb_image.h"
@@ -14,17 +17,32 @@ struct TextureDataFloat
 	{
 	}
 
-	float GetPixel(int w, int h, int c)
+	// read only image over pixels kept alive by owner (a file mapping), nothing is copied
+	static TextureDataFloat View(int w, int h, int c, const float* pixels, std::shared_ptr<const void> owner)
 	{
-		return data[h * width * channels + w * channels + c];
+		TextureDataFloat image;
+		image.width = w;
+		image.height = h;
+		image.channels = c;
+		image.view = pixels;
+		image.owner = std::move(owner);
+		return image;
 	}
 
-	glm::vec3 GetColorAt(int w, int h)
+	const float* Pixels() const
 	{
-		return glm::vec3(
-			data[h * width * channels + w * channels + 0],
-			data[h * width * channels + w * channels + 1],
-			data[h * width * channels + w * channels + 2]);
+		return view ? view : data.data();
+	}
+
+	float GetPixel(int w, int h, int c) const
+	{
+		return Pixels()[h * width * channels + w * channels + c];
+	}
+
+	glm::vec3 GetColorAt(int w, int h) const
+	{
+		const float* pixel = Pixels() + h * width * channels + w * channels;
+		return glm::vec3(pixel[0], pixel[1], pixel[2]);
 	}
 
 	void SetPixel(int w, int h, int c, float value)
@@ -39,57 +57,68 @@ struct TextureDataFloat
 		data[h * width * channels + w * channels + 2] = value.z;
 	}
 
+	// owned pixels, empty for views
 	std::vector<float> data;
+	const float* view = nullptr;
+	std::shared_ptr<const void> owner;
 
 	int width;
 	int height;
 	int channels;
 
+	// 8-bit [0, 255] to float [0.0, 1.0], grey images are replicated, alpha is dropped
+	static void FromDecodedImage(const DecodedImage& image, TextureDataFloat& out) {
+		out.height = image.height;
+		out.width = image.width;
+		out.channels = 3;
+		out.data.resize((image.width) * (image.height) * 3);
+
+		for (int i = 0; i < image.width * image.height; ++i) {
+			for (int c = 0; c < 3; ++c) {
+				int source = std::min(c, image.channels - 1);
+				out.data[i * 3 + c] = static_cast<float>(image.pixels[i * image.channels + source]) / 255.0f;
+			}
+		}
+	}
+
 	static int LoadTextureFromPNG(const char* filepath, TextureDataFloat& out) {
-		int width, height, channels;
-		unsigned char* image_data = stbi_load(filepath, &width, &height, &channels, 3); // Force 3 channels (RGB)
-		
 		std::cout<<"Loading Textures..."<<std::endl;
 
-		if(channels !=3)
-		{
-			std::runtime_error ("Only RGB channels are supported");
-			return 1;
+		try {
+			// Force 3 channels (RGB)
+			auto image = DecodeImage(filepath, 3);
+			FromDecodedImage(*image, out);
 		}
-
-		if (!image_data) {
-			std::runtime_error ("Couldn't load texture'");
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
 			return 1;
 		}
-
-		out.height = height;
-		out.width = width;
-		out.channels = channels;
-
-		// Create TextureDataFloat with the loaded dimensions and 3 channels
-		out.data.resize((width) * (height) * 3);
-
-		// Convert 8-bit data [0, 255] to float [0.0, 1.0]
-		for (int i = 0; i < width * height * 3; ++i) {
-			out.data[i] = static_cast<float>(image_data[i]) / 255.0f;
-		}
-
-		// Free the STB image data
-		stbi_image_free(image_data);
 		
 		std::cout<<"Finish loading texture"<<std::endl;
 		return 0;
 	}
 };
 
-static void CreateGLTextureFromTextureDataStruct(Texture& texture, const TextureDataFloat& im, GLenum wrapMode, bool generateMips){
+// glTexStorage* is core since 4.2 (macOS stops at 4.1)
+static bool HasImmutableTextureStorage()
+{
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	return major > 4 || (major == 4 && minor >= 2);
+}
+
+// internalFormat is GL_RGB16F or GL_RGB32F (GL_RGBA32F for 4 channels), the float data is never quantized to 8 bits
+static void CreateGLTextureFromTextureDataStruct(Texture& texture, const TextureDataFloat& im, GLenum wrapMode, bool generateMips,
+	GLenum internalFormat = GL_RGB16F){
 
-	if (im.data.empty())
+	if (im.width == 0 || im.height == 0)
 	{
 		std::runtime_error("Unable to create texture from empty texture data");
 		return;
 	}
 
+	GLenum format = im.channels == 4 ? GL_RGBA : GL_RGB;
 	glBindTexture(GL_TEXTURE_2D, texture.getHandle());
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
 		generateMips ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST);
@@ -97,10 +126,21 @@ static void CreateGLTextureFromTextureDataStruct(Texture& texture, const Texture
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, im.width, im.height, 0,
-				GL_RGB, GL_FLOAT, im.data.data());
+	// immutable allocation of the whole chain, then upload level 0
+	if (HasImmutableTextureStorage())
+	{
+		int levels = 1;
+		if (generateMips)
+			levels += (int)std::floor(std::log2((float)std::max(im.width, im.height)));
+		glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, im.width, im.height);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, im.width, im.height, format, GL_FLOAT, im.Pixels());
+	}
+	else
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, im.width, im.height, 0,
+					format, GL_FLOAT, im.Pixels());
+	}
 
-	
 	if (generateMips)
 		glGenerateMipmap(GL_TEXTURE_2D);
 	
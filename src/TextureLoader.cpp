@@ -0,0 +1,206 @@
+#include "TextureLoader.hpp"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+bool IsReady(const TextureLoader::DecodeFuture& image)
+{
+	return image.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+// size of a finished decode, 0 while running or failed
+size_t DecodedSize(const TextureLoader::DecodeFuture& image)
+{
+	if (!IsReady(image))
+		return 0;
+	try
+	{
+		return image.get()->pixels.size();
+	}
+	catch (const std::exception&)
+	{
+		return 0;
+	}
+}
+
+bool HasFailed(const TextureLoader::DecodeFuture& image)
+{
+	if (!IsReady(image))
+		return false;
+	try
+	{
+		image.get();
+		return false;
+	}
+	catch (const std::exception&)
+	{
+		return true;
+	}
+}
+}
+
+TextureLoader::TextureLoader(unsigned numThreads, size_t cacheBudget) : _pool(numThreads), _cacheBudget(cacheBudget)
+{
+}
+
+TextureLoader::~TextureLoader()
+{
+	for (InFlightUpload& upload : _inFlight)
+	{
+		glDeleteSync(upload.fence);
+		glDeleteBuffers(1, &upload.pbo);
+	}
+}
+
+TextureLoader::DecodeFuture TextureLoader::decode(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto found = _decodes.find(path);
+	if (found != _decodes.end() && !HasFailed(found->second.image))
+	{
+		found->second.lastUse = ++_useCount;
+		return found->second.image;
+	}
+
+	DecodeFuture future = _pool.submit([path]() -> std::shared_ptr<const DecodedImage> {
+		return DecodeImage(path);
+	}).share();
+	_decodes[path] = {future, ++_useCount};
+	evictDecodes();
+	return future;
+}
+
+void TextureLoader::evictDecodes()
+{
+	size_t cached = 0;
+	for (const auto& entry : _decodes)
+		cached += DecodedSize(entry.second.image);
+
+	// running decodes stay, their size isn't known yet; holders of a dropped future keep its image
+	while (cached > _cacheBudget)
+	{
+		auto oldest = _decodes.end();
+		for (auto it = _decodes.begin(); it != _decodes.end(); ++it)
+		{
+			if (IsReady(it->second.image) && (oldest == _decodes.end() || it->second.lastUse < oldest->second.lastUse))
+				oldest = it;
+		}
+		if (oldest == _decodes.end())
+			break;
+		cached -= DecodedSize(oldest->second.image);
+		_decodes.erase(oldest);
+	}
+}
+
+void TextureLoader::upload(const std::string& path, std::shared_ptr<Texture2D> texture, std::function<void(bool)> onUploaded)
+{
+	_uploads.push_back({path, decode(path), std::move(texture), std::move(onUploaded)});
+}
+
+void TextureLoader::invalidate(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_decodes.erase(path);
+}
+
+int TextureLoader::poll()
+{
+	// the mip chain is only built from a level 0 the GPU has finished copying
+	for (auto it = _inFlight.begin(); it != _inFlight.end();)
+	{
+		GLenum status = glClientWaitSync(it->fence, 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED)
+		{
+			++it;
+			continue;
+		}
+
+		bool success = status != GL_WAIT_FAILED;
+		glDeleteSync(it->fence);
+		glDeleteBuffers(1, &it->pbo);
+		try
+		{
+			if (!success)
+				throw std::runtime_error("pixel buffer transfer failure");
+			it->texture->generateMipmaps();
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "Couldn't load " << it->path << ": " << e.what() << std::endl;
+			success = false;
+		}
+		if (it->onUploaded)
+			it->onUploaded(success);
+		it = _inFlight.erase(it);
+	}
+
+	for (auto it = _uploads.begin(); it != _uploads.end();)
+	{
+		if (!IsReady(it->image))
+		{
+			++it;
+			continue;
+		}
+
+		InFlightUpload upload{it->path, std::move(it->texture), std::move(it->onUploaded)};
+		try
+		{
+			uploadThroughPBO(*it->image.get(), upload);
+			_inFlight.push_back(std::move(upload));
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "Couldn't load " << upload.path << ": " << e.what() << std::endl;
+			if (upload.onUploaded)
+				upload.onUploaded(false);
+		}
+		it = _uploads.erase(it);
+	}
+	return (int)(_uploads.size() + _inFlight.size());
+}
+
+void TextureLoader::uploadThroughPBO(const DecodedImage& image, InFlightUpload& upload)
+{
+	// one buffer per transfer, it is released once the fence has signaled
+	size_t pitch = (size_t)image.width * image.channels;
+	glGenBuffers(1, &upload.pbo);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.pbo);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, pitch * image.height, nullptr, GL_STREAM_DRAW);
+
+	// copy bottom row first, which also does the vertical flip OpenGL expects
+	auto* mapped = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, pitch * image.height,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+	bool unmapped = false;
+	if (mapped != nullptr)
+	{
+		for (int y = 0; y < image.height; y++)
+			memcpy(mapped + y * pitch, &image.pixels[(image.height - 1 - y) * pitch], pitch);
+		// GL_FALSE means the buffer contents were lost, e.g. on a display mode change
+		unmapped = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+	}
+	if (!unmapped)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &upload.pbo);
+		upload.pbo = 0;
+		throw std::runtime_error(mapped == nullptr ? "pixel buffer mapping failure" : "pixel buffer contents lost");
+	}
+
+	// the texture reads from the bound PBO, the copy runs asynchronously until the fence
+	try
+	{
+		upload.texture->upload(image.width, image.height, image.channels, nullptr, GL_UNSIGNED_BYTE, false);
+	}
+	catch (const std::exception&)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &upload.pbo);
+		upload.pbo = 0;
+		throw;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	upload.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+}
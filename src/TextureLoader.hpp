@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../base/texture.h"
+#include "../base/thread_pool.h"
+
+// Decodes image files on worker threads and streams them into textures
+// through pixel buffer objects. Each path is decoded once and the decoded
+// buffer is shared between the GL upload and the CPU precomputation; the
+// least recently used decodes are dropped beyond the cache budget.
+class TextureLoader
+{
+public:
+	using DecodeFuture = std::shared_future<std::shared_ptr<const DecodedImage>>;
+
+	explicit TextureLoader(unsigned numThreads = std::thread::hardware_concurrency(), size_t cacheBudget = 256u << 20);
+
+	~TextureLoader();
+
+	// start (or join) the decode of path, a failed decode is retried
+	DecodeFuture decode(const std::string& path);
+
+	// upload path into texture once decoded, onUploaded(success) runs on the GL thread after the
+	// GPU has finished the transfer and built the mipmaps; the loader keeps texture alive until then
+	void upload(const std::string& path, std::shared_ptr<Texture2D> texture, std::function<void(bool)> onUploaded = {});
+
+	// forget the decoded buffer of path so the next decode reads the file again
+	void invalidate(const std::string& path);
+
+	// GL thread, once per frame: starts the uploads of finished decodes and completes the
+	// transfers the GPU is done with, returns the number of uploads still pending
+	int poll();
+
+	// the decode workers, also used for CPU work depending on the decodes
+	ThreadPool& pool() { return _pool; }
+
+private:
+	struct CachedDecode
+	{
+		DecodeFuture image;
+		uint64_t lastUse = 0;
+	};
+
+	struct PendingUpload
+	{
+		std::string path;
+		DecodeFuture image;
+		std::shared_ptr<Texture2D> texture;
+		std::function<void(bool)> onUploaded;
+	};
+
+	// the PBO stays alive until the fence behind the copy out of it has signaled
+	struct InFlightUpload
+	{
+		std::string path;
+		std::shared_ptr<Texture2D> texture;
+		std::function<void(bool)> onUploaded;
+		GLuint pbo = 0;
+		GLsync fence = nullptr;
+	};
+
+	ThreadPool _pool;
+	std::mutex _mutex;
+	size_t _cacheBudget;
+	uint64_t _useCount = 0;
+	std::map<std::string, CachedDecode> _decodes;
+	std::vector<PendingUpload> _uploads;
+	std::vector<InFlightUpload> _inFlight;
+
+	// with _mutex held
+	void evictDecodes();
+
+	void uploadThroughPBO(const DecodedImage& image, InFlightUpload& upload);
+};
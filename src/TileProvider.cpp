@@ -0,0 +1,192 @@
+#include "TileProvider.hpp"
+#include <iostream>
+
+TileProvider::TileProvider(std::shared_ptr<const SynthExemplar> exemplar, int tileSize, size_t memoryBudget, unsigned numThreads)
+	: _exemplar(std::move(exemplar)), _tileSize(tileSize), _memoryBudget(memoryBudget), _pool(numThreads)
+{
+	_uvPerPixel = glm::vec2(1.0f / _exemplar->gaussian[0].width, 1.0f / _exemplar->gaussian[0].height);
+}
+
+TileProvider::~TileProvider() = default;
+
+void TileProvider::setExemplar(std::shared_ptr<const SynthExemplar> exemplar)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_exemplar = std::move(exemplar);
+	reset();
+}
+
+void TileProvider::setUVPerPixel(glm::vec2 uvPerPixel)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_uvPerPixel = uvPerPixel;
+	reset();
+}
+
+void TileProvider::setBlendMode(int blendMode)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_blendMode = blendMode;
+	reset();
+}
+
+void TileProvider::reset()
+{
+	// running fills keep their future for get(), the next request queues a fresh fill
+	_generation++;
+	_pending.clear();
+	_cache.clear();
+	_lru.clear();
+	_memoryUsed = 0;
+}
+
+void TileProvider::setMemoryBudget(size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_memoryBudget = bytes;
+	evict();
+}
+
+std::shared_ptr<const Tile> TileProvider::request(const TileKey& key)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto found = _cache.find(key);
+	if (found != _cache.end())
+	{
+		_stats.hits++;
+		_lru.splice(_lru.begin(), _lru, found->second.lru);
+		return found->second.tile;
+	}
+
+	queueFill(key);
+	return nullptr;
+}
+
+std::shared_ptr<const Tile> TileProvider::get(const TileKey& key)
+{
+	TileFuture future;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto found = _cache.find(key);
+		if (found != _cache.end())
+		{
+			_stats.hits++;
+			_lru.splice(_lru.begin(), _lru, found->second.lru);
+			return found->second.tile;
+		}
+		future = queueFill(key);
+	}
+	return future.get();
+}
+
+TileProvider::Stats TileProvider::stats()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	Stats stats = _stats;
+	stats.tiles = _cache.size();
+	stats.bytes = _memoryUsed;
+	return stats;
+}
+
+TileProvider::TileFuture TileProvider::queueFill(const TileKey& key)
+{
+	auto pending = _pending.find(key);
+	if (pending != _pending.end())
+		return pending->second;
+
+	_stats.misses++;
+	std::shared_ptr<const SynthExemplar> exemplar = _exemplar;
+	glm::vec2 uvPerPixel = _uvPerPixel;
+	int blendMode = _blendMode;
+	uint64_t generation = _generation;
+	TileFuture future = _pool.submit([this, exemplar, key, uvPerPixel, blendMode, generation]() {
+		std::shared_ptr<const Tile> tile = fill(*exemplar, key, uvPerPixel, blendMode);
+		std::lock_guard<std::mutex> lock(_mutex);
+		// tiles of an exemplar or settings that changed in the meantime are dropped,
+		// _pending then belongs to the new generation
+		if (generation == _generation)
+		{
+			_pending.erase(key);
+			insert(tile);
+		}
+		return tile;
+	}).share();
+	_pending[key] = future;
+	return future;
+}
+
+std::shared_ptr<const Tile> TileProvider::fill(const SynthExemplar& exemplar, const TileKey& key, glm::vec2 uvPerPixel, int blendMode) const
+{
+	auto tile = std::make_shared<Tile>();
+	tile->key = key;
+	tile->size = _tileSize;
+	tile->rgba.resize((size_t)_tileSize * _tileSize * 4);
+
+	glm::dvec2 origin;
+	glm::vec2 pixelUV;
+	TileFootprint(key, _tileSize, uvPerPixel, origin, pixelUV);
+	SynthesizeTile(exemplar, origin, pixelUV, _tileSize, _tileSize, blendMode, key.seed, tile->rgba.data());
+	return tile;
+}
+
+void TileProvider::insert(std::shared_ptr<const Tile> tile)
+{
+	// the key is copied first, the tile is moved into the cache below
+	TileKey key = tile->key;
+	if (_cache.count(key))
+		return;
+	_lru.push_front(key);
+	_memoryUsed += tile->rgba.size();
+	_cache[key] = {std::move(tile), _lru.begin()};
+	evict();
+}
+
+void TileProvider::evict()
+{
+	// tiles still held by callers stay alive through their shared_ptr
+	while (_memoryUsed > _memoryBudget && !_lru.empty())
+	{
+		auto found = _cache.find(_lru.back());
+		_memoryUsed -= found->second.tile->rgba.size();
+		_cache.erase(found);
+		_lru.pop_back();
+	}
+}
+
+int CheckTileProvider(std::shared_ptr<const SynthExemplar> exemplar)
+{
+	const int tileSize = 64;
+	const glm::vec2 uvPerPixel(1.0f / exemplar->gaussian[0].width, 1.0f / exemplar->gaussian[0].height);
+	int failures = 0;
+	auto check = [&](bool passed, const char* what) {
+		std::cout << (passed ? "[ OK ] " : "[FAIL] ") << what << std::endl;
+		failures += passed ? 0 : 1;
+	};
+	auto direct = [&](const TileKey& key, int blendMode) {
+		std::vector<unsigned char> rgba((size_t)tileSize * tileSize * 4);
+		glm::dvec2 origin;
+		glm::vec2 pixelUV;
+		TileFootprint(key, tileSize, uvPerPixel, origin, pixelUV);
+		SynthesizeTile(*exemplar, origin, pixelUV, tileSize, tileSize, blendMode, key.seed, rgba.data());
+		return rgba;
+	};
+
+	TileProvider provider(exemplar, tileSize, 4 * tileSize * tileSize * 4, 2);
+	const TileKey key = {1, -3, 2, 7};
+	check(provider.get(key)->rgba == direct(key, 2), "tile matches the direct synthesis");
+	check(provider.get(key) == provider.request(key) && provider.stats().hits == 2, "cached tile is a hit");
+
+	// a fill queued before the change must neither land in the cache nor answer later requests
+	const TileKey other = {0, 5, 5, 7};
+	provider.request(other);
+	provider.setBlendMode(0);
+	check(provider.get(other)->rgba == direct(other, 0), "fill of the old blend mode is dropped");
+	check(provider.get(key)->rgba == direct(key, 0), "cache is dropped with the blend mode");
+
+	for (int x = 0; x < 8; x++)
+		provider.get({0, x, 0, 7});
+	check(provider.stats().tiles <= 4 && provider.stats().bytes <= 4u * tileSize * tileSize * 4, "cache stays within its budget");
+
+	std::cout << (failures == 0 ? "Tile provider checks passed" : "Tile provider checks failed") << std::endl;
+	return failures;
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "SynthCPU.hpp"
+#include "../base/thread_pool.h"
+
+// Address of a tile, level 0 has uvPerPixel of the provider, each level doubles it.
+// The hash is deterministic, so a key names the same pixels on every machine.
+struct TileKey
+{
+	int level = 0;
+	int x = 0;
+	int y = 0;
+	uint32_t seed = 0; // hashSeed of the vertex offsets
+
+	bool operator==(const TileKey& other) const
+	{
+		return level == other.level && x == other.x && y == other.y && seed == other.seed;
+	}
+};
+
+struct TileKeyHash
+{
+	size_t operator()(const TileKey& key) const
+	{
+		uint64_t h = (uint64_t)(uint32_t)key.x * 0x9E3779B97F4A7C15ull;
+		h ^= ((uint64_t)(uint32_t)key.y + 0x632BE59BD9B4E019ull) * 0xC2B2AE3D27D4EB4Full;
+		h ^= (uint64_t)(uint32_t)key.level * 0x165667B19E3779F9ull;
+		h ^= (uint64_t)key.seed * 0xD6E8FEB86659FD93ull;
+		return (size_t)(h ^ (h >> 29));
+	}
+};
+
+// uv of the lower left corner of a tile and uv covered by one of its pixels
+inline void TileFootprint(const TileKey& key, int tileSize, glm::vec2 uvPerPixel, glm::dvec2& origin, glm::vec2& pixelUV)
+{
+	pixelUV = uvPerPixel * std::ldexp(1.0f, key.level);
+	origin = glm::dvec2((double)key.x * tileSize * pixelUV.x, (double)key.y * tileSize * pixelUV.y);
+}
+
+// RGBA8 pixels of a tile, bottom row first like the GL path
+struct Tile
+{
+	TileKey key;
+	int size = 0;
+	std::vector<unsigned char> rgba;
+};
+
+// Virtual texture over the infinite synthesized plane: tiles are evaluated with
+// the CPU blend on worker threads and kept in an LRU cache bounded in bytes.
+class TileProvider
+{
+public:
+	TileProvider(std::shared_ptr<const SynthExemplar> exemplar, int tileSize = 256, size_t memoryBudget = 256u << 20,
+		unsigned numThreads = std::thread::hardware_concurrency());
+
+	~TileProvider();
+
+	// the settings below drop the cache, fills started before the change are discarded
+	void setExemplar(std::shared_ptr<const SynthExemplar> exemplar);
+
+	// uv covered by a level 0 pixel, one exemplar texel by default
+	void setUVPerPixel(glm::vec2 uvPerPixel);
+
+	void setBlendMode(int blendMode);
+
+	void setMemoryBudget(size_t bytes);
+
+	int tileSize() const { return _tileSize; }
+
+	// cached tile or nullptr, in which case the tile is queued (page request)
+	std::shared_ptr<const Tile> request(const TileKey& key);
+
+	// cached tile, or fill it and wait
+	std::shared_ptr<const Tile> get(const TileKey& key);
+
+	struct Stats
+	{
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t tiles = 0;
+		size_t bytes = 0;
+	};
+	Stats stats();
+
+private:
+	using TileFuture = std::shared_future<std::shared_ptr<const Tile>>;
+
+	struct CacheEntry
+	{
+		std::shared_ptr<const Tile> tile;
+		std::list<TileKey>::iterator lru;
+	};
+
+	std::shared_ptr<const SynthExemplar> _exemplar;
+	int _tileSize;
+	glm::vec2 _uvPerPixel;
+	int _blendMode = 2;
+
+	std::mutex _mutex;
+	uint64_t _generation = 0; // of the exemplar and settings, fills of older ones are dropped
+	size_t _memoryBudget;
+	size_t _memoryUsed = 0;
+	std::list<TileKey> _lru; // front is the most recently used
+	std::unordered_map<TileKey, CacheEntry, TileKeyHash> _cache;
+	std::unordered_map<TileKey, TileFuture, TileKeyHash> _pending;
+	Stats _stats;
+
+	// last member, its workers are joined before the cache goes away
+	ThreadPool _pool;
+
+	// lock held, queues the fill of key if it is neither cached nor pending
+	TileFuture queueFill(const TileKey& key);
+
+	std::shared_ptr<const Tile> fill(const SynthExemplar& exemplar, const TileKey& key, glm::vec2 uvPerPixel, int blendMode) const;
+
+	// lock held, empties the cache and starts a new generation
+	void reset();
+
+	// lock held
+	void insert(std::shared_ptr<const Tile> tile);
+
+	// lock held
+	void evict();
+};
+
+// NoiseSynth --check-tiles: provider tiles against direct synthesis, cache hits,
+// eviction and settings changes during fills; 0 on success
+int CheckTileProvider(std::shared_ptr<const SynthExemplar> exemplar);
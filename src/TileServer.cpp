@@ -0,0 +1,542 @@
+#ifndef _WIN32
+#include "TileServer.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+	std::atomic<bool> interrupted{false};
+
+	void onSignal(int)
+	{
+		interrupted = true;
+	}
+
+	std::runtime_error systemError(const std::string& what)
+	{
+		return std::runtime_error(what + ": " + std::strerror(errno));
+	}
+
+	bool sendAll(int fd, const void* data, size_t size)
+	{
+		const char* p = static_cast<const char*>(data);
+		while (size > 0)
+		{
+			ssize_t n = ::send(fd, p, size, 0);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				return false;
+			p += n;
+			size -= n;
+		}
+		return true;
+	}
+
+	bool recvAll(int fd, void* data, size_t size)
+	{
+		char* p = static_cast<char*>(data);
+		while (size > 0)
+		{
+			ssize_t n = ::recv(fd, p, size, 0);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				return false;
+			p += n;
+			size -= n;
+		}
+		return true;
+	}
+
+	sockaddr_un socketAddress(const std::string& path)
+	{
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(address.sun_path))
+			throw std::runtime_error("socket path too long: " + path);
+		std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+		return address;
+	}
+
+	// only a socket nobody listens on is removed, anything else at the path is an error
+	void removeStaleSocket(const std::string& path, const sockaddr_un& address)
+	{
+		struct stat info;
+		if (lstat(path.c_str(), &info) != 0)
+			return;
+		if (!S_ISSOCK(info.st_mode))
+			throw std::runtime_error(path + " exists and is not a socket");
+
+		int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (probe < 0)
+			throw systemError("socket");
+		bool live = connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+		close(probe);
+		if (live)
+			throw std::runtime_error("a tile server is already listening on " + path);
+		unlink(path.c_str());
+	}
+}
+
+TileServer::TileServer(const std::string& socketPath, std::vector<std::shared_ptr<const SynthExemplar>> exemplars,
+	int tileSize, int slotCount, int blendMode)
+	: _socketPath(socketPath), _exemplars(std::move(exemplars)), _tileSize(tileSize), _slotCount(slotCount), _blendMode(blendMode)
+{
+	if (_exemplars.empty())
+		throw std::runtime_error("tile server needs at least one exemplar");
+
+	// arena
+	size_t slotBytes = (size_t)_tileSize * _tileSize * 4;
+	size_t tableBytes = sizeof(SharedTileArenaHeader) + sizeof(SharedTileSlot) * _slotCount;
+	size_t dataOffset = (tableBytes + 4095) & ~(size_t)4095;
+	_arenaBytes = dataOffset + slotBytes * _slotCount;
+
+	// the destructor does not run for a throwing constructor, what is open so far is released here
+	try
+	{
+		_shmName = "/noisesynth-tiles-" + std::to_string(getpid());
+		shm_unlink(_shmName.c_str());
+		_shmFd = shm_open(_shmName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		if (_shmFd < 0)
+			throw systemError("shm_open " + _shmName);
+		if (ftruncate(_shmFd, (off_t)_arenaBytes) != 0)
+			throw systemError("ftruncate " + _shmName);
+		void* mapped = mmap(nullptr, _arenaBytes, PROT_READ | PROT_WRITE, MAP_SHARED, _shmFd, 0);
+		if (mapped == MAP_FAILED)
+			throw systemError("mmap " + _shmName);
+		_arena = static_cast<unsigned char*>(mapped);
+
+		header() = {TILE_ARENA_MAGIC, TILE_ARENA_VERSION, (uint32_t)_tileSize, (uint32_t)_slotCount, slotBytes, dataOffset};
+		_lruPosition.resize(_slotCount);
+		_slotKey.resize(_slotCount);
+		for (int i = _slotCount - 1; i >= 0; i--)
+		{
+			new (&slot(i)) SharedTileSlot();
+			slot(i).sequence.store(0, std::memory_order_relaxed);
+			_freeSlots.push_back(i);
+		}
+
+		// socket
+		sockaddr_un address = socketAddress(_socketPath);
+		_listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (_listenFd < 0)
+			throw systemError("socket");
+		removeStaleSocket(_socketPath, address);
+		if (bind(_listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+			throw systemError("bind " + _socketPath);
+		_socketBound = true;
+		if (listen(_listenFd, 16) != 0)
+			throw systemError("listen " + _socketPath);
+	}
+	catch (...)
+	{
+		release();
+		throw;
+	}
+}
+
+void TileServer::release()
+{
+	if (_listenFd >= 0)
+	{
+		close(_listenFd);
+		_listenFd = -1;
+	}
+	if (_socketBound)
+	{
+		unlink(_socketPath.c_str());
+		_socketBound = false;
+	}
+	if (_arena)
+	{
+		munmap(_arena, _arenaBytes);
+		_arena = nullptr;
+	}
+	if (_shmFd >= 0)
+	{
+		close(_shmFd);
+		shm_unlink(_shmName.c_str());
+		_shmFd = -1;
+	}
+}
+
+TileServer::~TileServer()
+{
+	{
+		std::lock_guard<std::mutex> lock(_clientMutex);
+		for (Client& client : _clients)
+			if (!client.finished)
+				shutdown(client.fd, SHUT_RDWR);
+	}
+	for (Client& client : _clients)
+		client.thread.join();
+
+	release();
+}
+
+void TileServer::run()
+{
+	// dead clients must not kill the daemon
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+
+	std::cout << "Serving " << _exemplars.size() << " exemplars on " << _socketPath << ", arena " << _shmName << " ("
+			  << _slotCount << " tiles of " << _tileSize << "x" << _tileSize << ")" << std::endl;
+
+	_running = true;
+	while (_running && !interrupted)
+	{
+		reapClients();
+
+		pollfd listener = {_listenFd, POLLIN, 0};
+		if (poll(&listener, 1, 200) <= 0)
+			continue;
+
+		int fd = accept(_listenFd, nullptr, nullptr);
+		if (fd < 0)
+			continue;
+
+		std::lock_guard<std::mutex> lock(_clientMutex);
+		_clients.emplace_back();
+		_clients.back().fd = fd;
+		_clients.back().thread = std::thread([this, fd] { serveClient(fd); });
+	}
+
+	TileServerStats s = stats();
+	std::cout << "Tile server stopped: " << s.hits << " hits, " << s.misses << " misses, " << s.evictions << " evictions"
+			  << std::endl;
+}
+
+TileServerStats TileServer::stats()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	TileServerStats s = _stats;
+	std::lock_guard<std::mutex> clientLock(_clientMutex);
+	s.clients = std::count_if(_clients.begin(), _clients.end(), [](const Client& client) { return !client.finished; });
+	return s;
+}
+
+void TileServer::reapClients()
+{
+	std::list<Client> finished;
+	{
+		std::lock_guard<std::mutex> lock(_clientMutex);
+		for (auto it = _clients.begin(); it != _clients.end();)
+		{
+			auto next = std::next(it);
+			if (it->finished)
+				finished.splice(finished.end(), _clients, it);
+			it = next;
+		}
+	}
+	// the threads are past their last access to _clients
+	for (Client& client : finished)
+		client.thread.join();
+}
+
+void TileServer::serveClient(int fd)
+{
+	// the rest of a request is only read once magic and version match, other
+	// versions lay it out differently
+	const size_t headerSize = offsetof(TileRequestMessage, op);
+	TileRequestMessage request;
+	while (recvAll(fd, &request, headerSize))
+	{
+		TileResponseMessage response;
+		if (request.magic != TILE_PROTOCOL_MAGIC || request.version != TILE_PROTOCOL_VERSION)
+		{
+			response.status = request.magic != TILE_PROTOCOL_MAGIC ? TileStatusBadRequest : TileStatusBadVersion;
+			sendAll(fd, &response, sizeof(response));
+			break;
+		}
+		if (!recvAll(fd, reinterpret_cast<char*>(&request) + headerSize, sizeof(request) - headerSize))
+			break;
+
+		bool sent = false;
+		if (request.op == TileOpHello)
+		{
+			TileHelloMessage hello;
+			hello.tileSize = _tileSize;
+			hello.slotCount = _slotCount;
+			hello.exemplarCount = (uint32_t)_exemplars.size();
+			hello.blendMode = _blendMode;
+			hello.arenaBytes = _arenaBytes;
+			std::strncpy(hello.shmName, _shmName.c_str(), sizeof(hello.shmName) - 1);
+			sent = sendAll(fd, &response, sizeof(response)) && sendAll(fd, &hello, sizeof(hello));
+		}
+		else if (request.op == TileOpStats)
+		{
+			TileServerStats s = stats();
+			sent = sendAll(fd, &response, sizeof(response)) && sendAll(fd, &s, sizeof(s));
+		}
+		else if (request.op == TileOpGetTile)
+		{
+			response = handleTile(request);
+		}
+		else
+		{
+			response.status = TileStatusBadRequest;
+		}
+
+		if (!sent && !sendAll(fd, &response, sizeof(response)))
+			break;
+	}
+
+	std::lock_guard<std::mutex> lock(_clientMutex);
+	for (Client& client : _clients)
+		if (client.fd == fd && !client.finished)
+			client.finished = true;
+	close(fd);
+}
+
+TileResponseMessage TileServer::handleTile(const TileRequestMessage& request)
+{
+	TileResponseMessage response;
+	if (request.exemplar >= _exemplars.size())
+	{
+		response.status = TileStatusBadExemplar;
+		return response;
+	}
+
+	try
+	{
+		ServedKey key = {request.exemplar, {request.level, request.x, request.y, request.seed}};
+		for (;;)
+		{
+			int i = acquire(key);
+
+			// the sequence is only valid while the slot still holds key, a
+			// concurrent eviction in between sends us around again
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto found = _index.find(key);
+			if (found == _index.end() || found->second != i)
+				continue;
+			response.slot = i;
+			response.offset = header().dataOffset + header().slotBytes * i;
+			response.sequence = slot(i).sequence.load(std::memory_order_acquire);
+			break;
+		}
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "Tile " << request.level << " " << request.x << " " << request.y << ": " << e.what() << std::endl;
+		response.status = TileStatusError;
+	}
+	return response;
+}
+
+int TileServer::acquire(const ServedKey& key)
+{
+	for (;;)
+	{
+		std::shared_future<int> wait;
+		std::promise<int> promise;
+		int i = -1;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto found = _index.find(key);
+			if (found != _index.end())
+			{
+				_stats.hits++;
+				_lru.splice(_lru.begin(), _lru, _lruPosition[found->second]);
+				return found->second;
+			}
+
+			auto pending = _pending.find(key);
+			if (pending != _pending.end())
+			{
+				wait = pending->second;
+			}
+			else
+			{
+				_stats.misses++;
+				if (!_freeSlots.empty())
+				{
+					i = _freeSlots.back();
+					_freeSlots.pop_back();
+				}
+				else if (!_lru.empty())
+				{
+					i = _lru.back();
+					_lru.pop_back();
+					_index.erase(_slotKey[i]);
+					_stats.evictions++;
+				}
+				else
+				{
+					throw std::runtime_error("all tile slots are being filled");
+				}
+				_pending[key] = promise.get_future().share();
+			}
+		}
+
+		// another client fills this tile, look it up again once it is done
+		if (wait.valid())
+		{
+			wait.get();
+			continue;
+		}
+
+		SharedTileSlot& s = slot(i);
+		uint32_t sequence = s.sequence.load(std::memory_order_relaxed);
+		try
+		{
+			s.sequence.store(sequence + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			s.exemplar = key.exemplar;
+			s.level = key.tile.level;
+			s.x = key.tile.x;
+			s.y = key.tile.y;
+			s.seed = key.tile.seed;
+
+			// level 0 pixel is one texel of the requested exemplar, like TileProvider
+			const SynthExemplar& exemplar = *_exemplars[key.exemplar];
+			glm::vec2 uvPerPixel(1.0f / exemplar.gaussian[0].width, 1.0f / exemplar.gaussian[0].height);
+			glm::dvec2 origin;
+			glm::vec2 pixelUV;
+			TileFootprint(key.tile, _tileSize, uvPerPixel, origin, pixelUV);
+			SynthesizeTile(exemplar, origin, pixelUV, _tileSize, _tileSize, _blendMode, key.tile.seed, slotPixels(i));
+			s.sequence.store(sequence + 2, std::memory_order_release);
+		}
+		catch (...)
+		{
+			s.sequence.store(sequence + 2, std::memory_order_release);
+			std::lock_guard<std::mutex> lock(_mutex);
+			_pending.erase(key);
+			_freeSlots.push_back(i);
+			promise.set_exception(std::current_exception());
+			throw;
+		}
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		_index[key] = i;
+		_slotKey[i] = key;
+		_lru.push_front(i);
+		_lruPosition[i] = _lru.begin();
+		_pending.erase(key);
+		promise.set_value(i);
+		return i;
+	}
+}
+
+TileClient::TileClient(const std::string& socketPath)
+{
+	sockaddr_un address = socketAddress(socketPath);
+	_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (_fd < 0)
+		throw systemError("socket");
+	if (connect(_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		close(_fd);
+		throw systemError("connect " + socketPath);
+	}
+
+	TileRequestMessage request;
+	request.op = TileOpHello;
+	call(request, &_hello, sizeof(_hello));
+
+	int shmFd = shm_open(_hello.shmName, O_RDONLY, 0);
+	if (shmFd < 0)
+		throw systemError(std::string("shm_open ") + _hello.shmName);
+	void* mapped = mmap(nullptr, _hello.arenaBytes, PROT_READ, MAP_SHARED, shmFd, 0);
+	close(shmFd);
+	if (mapped == MAP_FAILED)
+		throw systemError(std::string("mmap ") + _hello.shmName);
+	_arena = static_cast<const unsigned char*>(mapped);
+
+	// a stale arena of another server build would be read with misaligned slots
+	const SharedTileArenaHeader& header = *reinterpret_cast<const SharedTileArenaHeader*>(_arena);
+	if (header.magic != TILE_ARENA_MAGIC || header.version != TILE_ARENA_VERSION || header.tileSize != _hello.tileSize ||
+		header.slotCount != _hello.slotCount)
+	{
+		munmap(mapped, _hello.arenaBytes);
+		_arena = nullptr;
+		close(_fd);
+		throw std::runtime_error("tile arena " + std::string(_hello.shmName) + " has version " +
+			std::to_string(header.version) + ", expected " + std::to_string(TILE_ARENA_VERSION));
+	}
+}
+
+TileClient::~TileClient()
+{
+	if (_arena)
+		munmap(const_cast<unsigned char*>(_arena), _hello.arenaBytes);
+	if (_fd >= 0)
+		close(_fd);
+}
+
+TileResponseMessage TileClient::call(const TileRequestMessage& request, void* payload, size_t payloadSize)
+{
+	TileResponseMessage response;
+	if (!sendAll(_fd, &request, sizeof(request)) || !recvAll(_fd, &response, sizeof(response)))
+		throw std::runtime_error("tile server disconnected");
+	if (response.magic != TILE_PROTOCOL_MAGIC)
+		throw std::runtime_error("bad tile server response");
+	if (response.version != TILE_PROTOCOL_VERSION || response.status == TileStatusBadVersion)
+		throw std::runtime_error("tile server speaks another protocol version, expected " + std::to_string(TILE_PROTOCOL_VERSION));
+	if (response.status == TileStatusOk && payload && !recvAll(_fd, payload, payloadSize))
+		throw std::runtime_error("tile server disconnected");
+	if (response.status != TileStatusOk)
+		throw std::runtime_error("tile request failed with status " + std::to_string(response.status));
+	return response;
+}
+
+TileClient::TileView TileClient::get(uint32_t exemplar, const TileKey& key)
+{
+	TileRequestMessage request;
+	request.op = TileOpGetTile;
+	request.exemplar = exemplar;
+	request.level = key.level;
+	request.x = key.x;
+	request.y = key.y;
+	request.seed = key.seed;
+	TileResponseMessage response = call(request, nullptr, 0);
+
+	TileView view;
+	view.rgba = _arena + response.offset;
+	view.slot = response.slot;
+	view.sequence = response.sequence;
+	return view;
+}
+
+bool TileClient::valid(const TileView& view) const
+{
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return slot(view.slot).sequence.load(std::memory_order_relaxed) == view.sequence;
+}
+
+void TileClient::copy(uint32_t exemplar, const TileKey& key, std::vector<unsigned char>& rgba)
+{
+	rgba.resize((size_t)_hello.tileSize * _hello.tileSize * 4);
+	for (;;)
+	{
+		TileView view = get(exemplar, key);
+		std::memcpy(rgba.data(), view.rgba, rgba.size());
+		if (valid(view))
+			return;
+	}
+}
+
+TileServerStats TileClient::stats()
+{
+	TileRequestMessage request;
+	request.op = TileOpStats;
+	TileServerStats s;
+	call(request, &s, sizeof(s));
+	return s;
+}
+#endif
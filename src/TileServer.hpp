@@ -0,0 +1,233 @@
+#pragma once
+#ifndef _WIN32
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "TileProvider.hpp"
+
+// Tile daemon: exemplars are loaded and precomputed once, tiles are synthesized
+// into a shared memory arena and served over a Unix domain socket. A response
+// only carries the slot of the tile in the arena, clients read the pixels in
+// place (zero copy) and validate them with the slot sequence number (seqlock).
+// Both sides reject a peer or an arena of another version.
+
+#define TILE_PROTOCOL_MAGIC 0x4E535446u // "NSTF"
+#define TILE_PROTOCOL_VERSION 2u		// 2: seed in requests, version in requests and responses
+#define TILE_ARENA_MAGIC 0x4E535441u	// "NSTA"
+#define TILE_ARENA_VERSION 2u			// 2: seed in slots
+
+enum TileOp : uint32_t
+{
+	TileOpHello = 1, // response followed by TileHelloMessage
+	TileOpGetTile = 2,
+	TileOpStats = 3, // response followed by TileServerStats
+};
+
+enum TileStatus : int32_t
+{
+	TileStatusOk = 0,
+	TileStatusBadRequest = -1,
+	TileStatusBadExemplar = -2,
+	TileStatusError = -3,
+	TileStatusBadVersion = -4, // the connection is closed after the response
+};
+
+// magic and version come first in every version, the server reads them before the rest
+struct TileRequestMessage
+{
+	uint32_t magic = TILE_PROTOCOL_MAGIC;
+	uint32_t version = TILE_PROTOCOL_VERSION;
+	uint32_t op = TileOpGetTile;
+	uint32_t exemplar = 0;
+	int32_t level = 0;
+	int32_t x = 0;
+	int32_t y = 0;
+	uint32_t seed = 0;
+};
+
+struct TileResponseMessage
+{
+	uint32_t magic = TILE_PROTOCOL_MAGIC;
+	uint32_t version = TILE_PROTOCOL_VERSION;
+	int32_t status = TileStatusOk;
+	uint32_t slot = 0;
+	uint32_t sequence = 0; // even, the slot holds the tile while it is unchanged
+	uint32_t pad = 0;
+	uint64_t offset = 0;   // of the RGBA8 pixels in the arena
+};
+
+struct TileHelloMessage
+{
+	uint32_t tileSize = 0;
+	uint32_t slotCount = 0;
+	uint32_t exemplarCount = 0;
+	uint32_t blendMode = 0;
+	uint64_t arenaBytes = 0;
+	char shmName[64] = {};
+};
+
+struct TileServerStats
+{
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t evictions = 0;
+	uint64_t clients = 0;
+};
+
+// Layout of the shared memory: header, slot table, then slotCount tiles of
+// tileSize * tileSize RGBA8 pixels (bottom row first) starting at dataOffset
+struct SharedTileArenaHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t tileSize;
+	uint32_t slotCount;
+	uint64_t slotBytes;
+	uint64_t dataOffset;
+};
+
+struct SharedTileSlot
+{
+	std::atomic<uint32_t> sequence; // odd while the server rewrites the slot
+	uint32_t exemplar;
+	int32_t level;
+	int32_t x;
+	int32_t y;
+	uint32_t seed;
+	uint32_t pad[2];
+};
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "slot sequence must be usable across processes");
+
+class TileServer
+{
+public:
+	TileServer(const std::string& socketPath, std::vector<std::shared_ptr<const SynthExemplar>> exemplars,
+		int tileSize = 256, int slotCount = 1024, int blendMode = 2);
+
+	~TileServer();
+
+	// accepts clients until stop() or SIGINT / SIGTERM
+	void run();
+
+	void stop() { _running = false; }
+
+	TileServerStats stats();
+
+private:
+	struct ServedKey
+	{
+		uint32_t exemplar;
+		TileKey tile;
+
+		bool operator==(const ServedKey& other) const { return exemplar == other.exemplar && tile == other.tile; }
+	};
+
+	struct ServedKeyHash
+	{
+		size_t operator()(const ServedKey& key) const { return TileKeyHash()(key.tile) * 31 + key.exemplar; }
+	};
+
+	std::string _socketPath;
+	std::string _shmName;
+	std::vector<std::shared_ptr<const SynthExemplar>> _exemplars;
+	int _tileSize;
+	int _slotCount;
+	int _blendMode;
+
+	int _listenFd = -1;
+	bool _socketBound = false; // the socket file is ours to unlink
+	int _shmFd = -1;
+	unsigned char* _arena = nullptr;
+	size_t _arenaBytes = 0;
+	std::atomic<bool> _running{false};
+
+	std::mutex _mutex;
+	std::unordered_map<ServedKey, int, ServedKeyHash> _index;
+	std::unordered_map<ServedKey, std::shared_future<int>, ServedKeyHash> _pending;
+	std::list<int> _lru; // ready slots, front is the most recently used
+	std::vector<std::list<int>::iterator> _lruPosition;
+	std::vector<ServedKey> _slotKey;
+	std::vector<int> _freeSlots;
+	TileServerStats _stats;
+
+	// one thread per connection, joined by the accept loop once its client has gone
+	struct Client
+	{
+		int fd = -1;
+		std::thread thread;
+		bool finished = false;
+	};
+
+	std::mutex _clientMutex;
+	std::list<Client> _clients;
+
+	SharedTileArenaHeader& header() { return *reinterpret_cast<SharedTileArenaHeader*>(_arena); }
+	SharedTileSlot& slot(int i) { return reinterpret_cast<SharedTileSlot*>(_arena + sizeof(SharedTileArenaHeader))[i]; }
+	unsigned char* slotPixels(int i) { return _arena + header().dataOffset + header().slotBytes * i; }
+
+	// closes and unlinks the socket and the arena, for the destructor and a failed constructor
+	void release();
+
+	void serveClient(int fd);
+
+	// joins the threads of finished clients
+	void reapClients();
+
+	TileResponseMessage handleTile(const TileRequestMessage& request);
+
+	// slot holding key, synthesizing it into a free or evicted slot on a miss
+	int acquire(const ServedKey& key);
+};
+
+// Client side of the daemon protocol, maps the arena read only
+class TileClient
+{
+public:
+	explicit TileClient(const std::string& socketPath);
+
+	~TileClient();
+
+	TileClient(const TileClient&) = delete;
+	TileClient& operator=(const TileClient&) = delete;
+
+	const TileHelloMessage& info() const { return _hello; }
+
+	// pixels in place in the arena, usable while valid() holds
+	struct TileView
+	{
+		const unsigned char* rgba = nullptr;
+		uint32_t slot = 0;
+		uint32_t sequence = 0;
+	};
+
+	// throws on protocol errors
+	TileView get(uint32_t exemplar, const TileKey& key);
+
+	// false once the server reused the slot of view, get() it again
+	bool valid(const TileView& view) const;
+
+	// consistent copy of the tile, retries while the slot is rewritten
+	void copy(uint32_t exemplar, const TileKey& key, std::vector<unsigned char>& rgba);
+
+	TileServerStats stats();
+
+private:
+	int _fd = -1;
+	TileHelloMessage _hello;
+	const unsigned char* _arena = nullptr;
+
+	const SharedTileSlot& slot(uint32_t i) const
+	{
+		return reinterpret_cast<const SharedTileSlot*>(_arena + sizeof(SharedTileArenaHeader))[i];
+	}
+
+	TileResponseMessage call(const TileRequestMessage& request, void* payload, size_t payloadSize);
+};
+#endif
@@ -0,0 +1,55 @@
+#include "VertexOffsets.hpp"
+#include "SynthGrid.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	glm::vec2 Random(uint32_t i, uint32_t stream, uint32_t seed)
+	{
+		glm::uvec2 h = Pcg2d(glm::uvec2(i + seed * 0x9E3779B9u, stream + seed * 0x85EBCA6Bu));
+		return glm::vec2((float)(h.x >> 8), (float)(h.y >> 8)) * (1.0f / 16777216.0f);
+	}
+}
+
+std::shared_ptr<const VertexOffsetTable> BuildVertexOffsetTable(const VertexOffsetParameters& parameters)
+{
+	int size = 1;
+	while (size < std::max(1, parameters.size))
+		size *= 2;
+	uint32_t count = (uint32_t)size * size;
+
+	// one jittered offset per cell of a size x size grid over the exemplar
+	std::vector<glm::vec2> offsets(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		glm::vec2 cell((float)(i % size), (float)(i / size));
+		offsets[i] = (cell + Random(i, 0u, parameters.seed)) / (float)size;
+	}
+
+	// and shuffled over the vertices (Fisher-Yates)
+	for (uint32_t i = count - 1; i > 0; i--)
+	{
+		uint32_t j = Pcg2d(glm::uvec2(i, parameters.seed)).x % (i + 1);
+		std::swap(offsets[i], offsets[j]);
+	}
+
+	auto table = std::make_shared<VertexOffsetTable>();
+	table->parameters = parameters;
+	table->parameters.size = size;
+	table->texels = TextureDataFloat(size, size, 4);
+	float maxScale = std::max(0.0f, std::min(parameters.scale, 0.5f));
+	for (uint32_t i = 0; i < count; i++)
+	{
+		glm::vec2 jitter = Random(i, 1u, parameters.seed);
+		float angle = (2.0f * jitter.x - 1.0f) * parameters.rotation;
+		float scale = 1.0f - maxScale * jitter.y;
+		float* texel = &table->texels.data[(size_t)i * 4];
+		texel[0] = offsets[i].x;
+		texel[1] = offsets[i].y;
+		texel[2] = scale * std::cos(angle);
+		texel[3] = scale * std::sin(angle);
+	}
+	return table;
+}
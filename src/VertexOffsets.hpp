@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <glm/glm.hpp>
+#include "TextureDataFloat.hpp"
+
+// Per-vertex offsets read from a wrapping table instead of hashed, indexed by
+// the vertex ID modulo its size. The offsets of one table period are a
+// shuffled jittered grid, so every part of the exemplar is used equally
+// often, and each vertex can rotate and shrink its window around the vertex.
+// The table is RGBA32F and read with texelFetch, CPU and GPU see the same floats.
+
+struct VertexOffsetParameters
+{
+	// side of the table, a power of two; the pattern repeats every size / 3.464 uv
+	int size = 256;
+	// largest rotation of a window in radians, pi for any orientation
+	float rotation = 0.0f;
+	// windows shrink by up to this fraction (features grow), in [0, 0.5];
+	// they never grow so the seam-aware windows stay valid
+	float scale = 0.0f;
+	uint32_t seed = 0;
+
+	bool operator==(const VertexOffsetParameters& other) const
+	{
+		return size == other.size && rotation == other.rotation && scale == other.scale && seed == other.seed;
+	}
+};
+
+struct VertexOffsetTable
+{
+	VertexOffsetParameters parameters;
+	// size x size x 4: offset in [0, 1)^2, then (a, b) = s * (cos, sin) of the window transform
+	TextureDataFloat texels;
+};
+
+std::shared_ptr<const VertexOffsetTable> BuildVertexOffsetTable(const VertexOffsetParameters& parameters);
+
+// texel of a vertex, same as the texelFetch in synth_common.glsl
+inline glm::vec4 FetchVertexOffset(const VertexOffsetTable& table, glm::ivec2 vertex)
+{
+	uint32_t mask = (uint32_t)table.texels.width - 1;
+	int x = (int)((uint32_t)vertex.x & mask), y = (int)((uint32_t)vertex.y & mask);
+	const float* texel = table.texels.Pixels() + ((size_t)y * table.texels.width + x) * 4;
+	return glm::vec4(texel[0], texel[1], texel[2], texel[3]);
+}
@@ -0,0 +1,139 @@
+#include "VolumeBake.hpp"
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <stdexcept>
+
+VolumeBrickWriter::VolumeBrickWriter(const std::string& filename, int width, int height, int depth, int brickSize)
+	: _file(filename, std::ios::binary), _filename(filename)
+{
+	if (!_file)
+		throw std::runtime_error("cannot open " + filename);
+
+	_header.width = width;
+	_header.height = height;
+	_header.depth = depth;
+	_header.brickSize = brickSize;
+	_bricks = glm::ivec3((width + brickSize - 1) / brickSize, (height + brickSize - 1) / brickSize,
+		(depth + brickSize - 1) / brickSize);
+	_file.write(reinterpret_cast<const char*>(&_header), sizeof(_header));
+}
+
+void VolumeBrickWriter::writeBrick(glm::ivec3 brick, const unsigned char* rgba)
+{
+	uint64_t brickBytes = (uint64_t)_header.brickSize * _header.brickSize * _header.brickSize * 4;
+	uint64_t index = ((uint64_t)brick.z * _bricks.y + brick.y) * _bricks.x + brick.x;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_file.seekp((std::streamoff)(sizeof(VolumeBrickHeader) + index * brickBytes));
+	_file.write(reinterpret_cast<const char*>(rgba), (std::streamsize)brickBytes);
+}
+
+void VolumeBrickWriter::finish()
+{
+	_file.close();
+	if (!_file)
+		throw std::runtime_error("failed to write " + _filename);
+}
+
+void ReadVolumeBricks(const std::string& path, int& width, int& height, int& depth, std::vector<float>& rgb)
+{
+	std::ifstream file(path, std::ios::binary);
+	VolumeBrickHeader header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != VOLUME_BRICK_MAGIC ||
+		header.channels != 4 || header.brickSize == 0)
+		throw std::runtime_error(path + " is not a bricked volume");
+
+	width = header.width;
+	height = header.height;
+	depth = header.depth;
+	int b = header.brickSize;
+	rgb.assign((size_t)width * height * depth * 3, 0.0f);
+
+	std::vector<unsigned char> brick((size_t)b * b * b * 4);
+	for (int bz = 0; bz < (depth + b - 1) / b; bz++)
+	for (int by = 0; by < (height + b - 1) / b; by++)
+	for (int bx = 0; bx < (width + b - 1) / b; bx++)
+	{
+		if (!file.read(reinterpret_cast<char*>(brick.data()), brick.size()))
+			throw std::runtime_error(path + " is truncated");
+		for (int z = 0; z < b && bz * b + z < depth; z++)
+		for (int y = 0; y < b && by * b + y < height; y++)
+		for (int x = 0; x < b && bx * b + x < width; x++)
+		{
+			const unsigned char* in = &brick[(((size_t)z * b + y) * b + x) * 4];
+			float* out = &rgb[(((size_t)(bz * b + z) * height + by * b + y) * width + bx * b + x) * 3];
+			for (int c = 0; c < 3; c++)
+				out[c] = in[c] / 255.0f;
+		}
+	}
+}
+
+std::shared_ptr<VolumeExemplar> LoadVolumeExemplar(const std::string& sourcePath, const std::string& gaussianPath)
+{
+	auto exemplar = std::make_shared<VolumeExemplar>();
+	int width, height, depth;
+	ReadVolumeBricks(sourcePath, exemplar->width, exemplar->height, exemplar->depth, exemplar->source);
+	ReadVolumeBricks(gaussianPath, width, height, depth, exemplar->gaussian);
+	if (width != exemplar->width || height != exemplar->height || depth != exemplar->depth)
+		throw std::runtime_error(sourcePath + " and " + gaussianPath + " differ in size");
+
+	// the statistics only look at the voxel values, slices stacked as one image will do
+	TextureDataFloat voxels(exemplar->width, exemplar->height * exemplar->depth, 3);
+	voxels.data = exemplar->source;
+	PrecomputeExemplar(voxels, exemplar->precompute, ChooseLUTWidth(voxels));
+	return exemplar;
+}
+
+VolumeBakeStats BakeVolume(VolumeBrickWriter& writer, float uvPerVoxel, const std::function<glm::vec3(glm::vec3)>& voxel,
+	ThreadPool& pool)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	const VolumeBrickHeader& header = writer.header();
+	int b = header.brickSize;
+	size_t brickBytes = (size_t)b * b * b * 4;
+	glm::ivec3 bricks = writer.brickCount();
+
+	auto fill = [&writer, &voxel, &header, b, brickBytes, uvPerVoxel](glm::ivec3 brick) {
+		std::vector<unsigned char> rgba(brickBytes, 0);
+		for (int z = 0; z < b && brick.z * b + z < (int)header.depth; z++)
+		for (int y = 0; y < b && brick.y * b + y < (int)header.height; y++)
+		for (int x = 0; x < b && brick.x * b + x < (int)header.width; x++)
+		{
+			glm::vec3 p = (glm::vec3(brick * b + glm::ivec3(x, y, z)) + glm::vec3(0.5f)) * uvPerVoxel;
+			glm::vec3 color = glm::clamp(voxel(p), 0.0f, 1.0f);
+			unsigned char* out = &rgba[(((size_t)z * b + y) * b + x) * 4];
+			out[0] = (unsigned char)std::lround(color.r * 255.0f);
+			out[1] = (unsigned char)std::lround(color.g * 255.0f);
+			out[2] = (unsigned char)std::lround(color.b * 255.0f);
+			out[3] = 255;
+		}
+		writer.writeBrick(brick, rgba.data());
+	};
+
+	// bounded queue of bricks in flight
+	size_t maxInFlight = 2 * pool.size();
+	std::deque<std::future<void>> inFlight;
+	for (int bz = 0; bz < bricks.z; bz++)
+	for (int by = 0; by < bricks.y; by++)
+	for (int bx = 0; bx < bricks.x; bx++)
+	{
+		if (inFlight.size() >= maxInFlight)
+		{
+			inFlight.front().get();
+			inFlight.pop_front();
+		}
+		glm::ivec3 brick(bx, by, bz);
+		inFlight.push_back(pool.submit([fill, brick] { fill(brick); }));
+	}
+	for (auto& brick : inFlight)
+		brick.get();
+	writer.finish();
+
+	VolumeBakeStats stats;
+	stats.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	stats.megaVoxelsPerSecond = (double)header.width * header.height * header.depth / 1e6 / stats.seconds;
+	stats.bytesInFlight = maxInFlight * brickBytes;
+	return stats;
+}
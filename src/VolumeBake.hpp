@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "SynthCPU.hpp"
+#include "../base/thread_pool.h"
+
+// Bricked volumes: a VolumeBrickHeader, then the bricks in z, y, x order, each
+// brickSize^3 RGBA8 voxels with x fastest, edge bricks zero padded. Brick
+// offsets only depend on the brick index, so bricks can be written in any order.
+#define VOLUME_BRICK_MAGIC 0x4256534Eu // "NSVB"
+
+struct VolumeBrickHeader
+{
+	uint32_t magic = VOLUME_BRICK_MAGIC;
+	uint32_t version = 1;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t depth = 0;
+	uint32_t brickSize = 0;
+	uint32_t channels = 4;
+	uint32_t reserved = 0;
+};
+
+class VolumeBrickWriter
+{
+public:
+	VolumeBrickWriter(const std::string& filename, int width, int height, int depth, int brickSize = 64);
+
+	const VolumeBrickHeader& header() const { return _header; }
+
+	glm::ivec3 brickCount() const { return _bricks; }
+
+	// thread safe, rgba holds brickSize^3 voxels
+	void writeBrick(glm::ivec3 brick, const unsigned char* rgba);
+
+	void finish();
+
+private:
+	std::mutex _mutex;
+	std::ofstream _file;
+	std::string _filename;
+	VolumeBrickHeader _header;
+	glm::ivec3 _bricks;
+};
+
+// reads a whole bricked volume as RGB floats, x fastest (for small 3D exemplars)
+void ReadVolumeBricks(const std::string& path, int& width, int& height, int& depth, std::vector<float>& rgb);
+
+// 3D exemplar from a source and a gaussianized volume, precomputed like the 2D ones
+std::shared_ptr<VolumeExemplar> LoadVolumeExemplar(const std::string& sourcePath, const std::string& gaussianPath);
+
+struct VolumeBakeStats
+{
+	double seconds = 0.0;
+	double megaVoxelsPerSecond = 0.0;
+	size_t bytesInFlight = 0;
+};
+
+// fills every brick of writer on pool with voxel(p), p the voxel center in uv
+// units; at most two bricks per worker are in memory at once
+VolumeBakeStats BakeVolume(VolumeBrickWriter& writer, float uvPerVoxel, const std::function<glm::vec3(glm::vec3)>& voxel,
+	ThreadPool& pool);
@@ -17,7 +17,9 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 // ----------------------------------------------------------------------------
 
+#pragma once
 
+#include <cmath>
 #include <vector>
 
 // Calculates the eigenvalues and normalized eigenvectors of a symmetric 3x3
@@ -34,7 +36,7 @@
 // Return value:
 //		0: Success
 //		-1: Error (no convergence)
-int ComputeEigenValuesAndVectors(double A[3][3], double Q[3][3], double w[3])
+inline int ComputeEigenValuesAndVectors(double A[3][3], double Q[3][3], double w[3])
 {
 	const int n = 3;
 	double sd, so;                  // Sums of diagonal resp. off-diagonal elements
@@ -1,10 +1,227 @@
 #include "NoiseSynth.hpp"
+#include "QualityMetrics.hpp"
+#include "StreamingBake.hpp"
+#include "SynthAnimator.hpp"
+#include "TileServer.hpp"
+#include "VolumeBake.hpp"
+
+namespace
+{
+// removes "name [value]" from the arguments wherever it is, the positional forms below stay as they are
+bool TakeOption(int& argc, char** argv, const std::string& name, std::string* value = nullptr)
+{
+	for (int i = 2; i < argc; i++)
+	{
+		if (argv[i] != name)
+			continue;
+		int count = value ? 2 : 1;
+		if (i + count > argc)
+			throw std::runtime_error("missing value for " + name);
+		if (value)
+			*value = argv[i + 1];
+		std::copy(argv + i + count, argv + argc, argv + i);
+		argc -= count;
+		return true;
+	}
+	return false;
+}
+}
 
 // #define DEBUG
-int main()
+int main(int argc, char** argv)
 {
 	try
 	{
+		// bakes take [--seed <n>] anywhere after the mode, the hashSeed of the GUI
+		std::string seedOption;
+		uint32_t hashSeed = TakeOption(argc, argv, "--seed", &seedOption) ? (uint32_t)std::stoul(seedOption) : 0;
+
+		// the CPU backends take [--no-seam-offsets], the GUI "Seam-aware Offsets" switched off
+		SynthOptions options;
+		options.seamAware = !TakeOption(argc, argv, "--no-seam-offsets");
+
+		// and [--offset-table <log2 size>] [--offset-rotation <radians>] [--offset-scale <fraction>],
+		// the GUI "Precomputed Offsets", seeded with --seed
+		std::string offsetOption;
+		options.offsetTable = TakeOption(argc, argv, "--offset-table", &offsetOption);
+		if (options.offsetTable)
+		{
+			int log2Size = std::stoi(offsetOption);
+			if (log2Size < 0 || log2Size > 12)
+				throw std::runtime_error("--offset-table takes a log2 size in [0, 12]");
+			options.vertexOffsets.size = 1 << log2Size;
+		}
+		if (TakeOption(argc, argv, "--offset-rotation", &offsetOption))
+			options.vertexOffsets.rotation = std::stof(offsetOption);
+		if (TakeOption(argc, argv, "--offset-scale", &offsetOption))
+			options.vertexOffsets.scale = std::stof(offsetOption);
+		options.vertexOffsets.seed = hashSeed;
+
+		// NoiseSynth --bake-gpu <width> <height> <output.png> [blendMode]
+		if ((argc == 5 || argc == 6) && std::string(argv[1]) == "--bake-gpu")
+		{
+			NoiseSynth app("../data", true);
+			app.setHashSeed((int)hashSeed);
+			app.setBlendMode(argc == 6 ? std::stoi(argv[5]) : 2);
+			app.setSynthOptions(options);
+			return app.bakeCompute(std::stoi(argv[2]), std::stoi(argv[3]), argv[4]) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		// NoiseSynth --golden <directory> [--update], every blendMode against the stored references
+		if ((argc == 3 || argc == 4) && std::string(argv[1]) == "--golden")
+		{
+			NoiseSynth app("../data", true);
+			bool update = argc == 4 && std::string(argv[3]) == "--update";
+			return app.checkGolden(argv[2], update) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		// NoiseSynth --convert-exemplar <noise.png> <gaussian.png> <output.nsx> [float32|unorm16]
+		if ((argc == 5 || argc == 6) && std::string(argv[1]) == "--convert-exemplar")
+		{
+			bool unorm16 = argc == 6 && std::string(argv[5]) == "unorm16";
+			ConvertExemplar(argv[2], argv[3], argv[4], unorm16 ? ExemplarFileUnorm16 : ExemplarFileFloat32);
+			return EXIT_SUCCESS;
+		}
+
+		// NoiseSynth --bake-cpu <width> <height> <output.png|output.raw|output.dds> [blendMode] [exemplar.nsx], no window
+		if (argc >= 5 && argc <= 7 && std::string(argv[1]) == "--bake-cpu")
+		{
+			auto exemplar = argc == 7 ? LoadSynthExemplar(argv[6], options) : LoadSynthExemplar(noiseTexturePath, gaussianTexturePath, options);
+			glm::vec2 uvPerPixel(1.0f / exemplar->gaussian[0].width, 1.0f / exemplar->gaussian[0].height);
+			int width = std::stoi(argv[2]), height = std::stoi(argv[3]);
+			int blendMode = argc >= 6 ? std::stoi(argv[5]) : 2;
+
+			ThreadPool pool;
+			if (blendMode == 6)
+				exemplar->lut3D = std::make_shared<InverseLUT3D>(
+					BuildInverseLUT3D(exemplar->source[0], exemplar->gaussian[0], 32, pool));
+			else if (blendMode == 7)
+				exemplar->pyramid = std::make_shared<const ExemplarPyramid>(exemplar->source[0]);
+			auto sink = CreateRowSink(argv[4]);
+
+			// the rows are measured against the exemplar on their way to the file
+			const TextureDataFloat& source = exemplar->source[0];
+			int spectrumTile = ChooseSpectrumTile(source.width, source.height);
+			ImageStatistics exemplarStatistics = ComputeStatistics(source, exemplar->precompute, spectrumTile, pool);
+			QualitySink quality(*sink, exemplar->precompute, spectrumTile, pool);
+			StreamingBakeStats stats = StreamingBake(*exemplar, width, height, uvPerPixel, blendMode, hashSeed, quality, pool);
+			std::cout << "CPU bake " << width << "x" << height << " in " << stats.seconds << " s ("
+					  << stats.megaPixelsPerSecond << " Mpix/s, " << pool.size() << " threads, "
+					  << 2 * stats.bandBytes / (1 << 20) << " MB of bands)" << std::endl;
+			PrintQualityReport(std::cout, CompareStatistics(exemplarStatistics, quality.statistics()));
+			return EXIT_SUCCESS;
+		}
+
+		// NoiseSynth --check-tiles [exemplar.nsx], TileProvider self-check, no window
+		if ((argc == 2 || argc == 3) && std::string(argv[1]) == "--check-tiles")
+		{
+			// the default gaussian is written by gaussianize.py and not part of a checkout, 77 is the ctest skip code
+			if (argc == 2 && (!std::filesystem::exists(noiseTexturePath) || !std::filesystem::exists(gaussianTexturePath)))
+			{
+				std::cerr << "Tile provider check skipped, " << gaussianTexturePath
+						  << " is missing: run gaussianize.py or pass an exemplar.nsx" << std::endl;
+				return 77;
+			}
+			auto exemplar = argc == 3 ? LoadSynthExemplar(argv[2], options) : LoadSynthExemplar(noiseTexturePath, gaussianTexturePath, options);
+			return CheckTileProvider(exemplar) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		// NoiseSynth --bake-animation <width> <height> <frames> <output_prefix> [blendMode], 30 fps PNG frames, no window
+		if ((argc == 6 || argc == 7) && std::string(argv[1]) == "--bake-animation")
+		{
+			auto exemplar = LoadSynthExemplar(noiseTexturePath, gaussianTexturePath, options);
+			glm::vec2 uvPerPixel(1.0f / exemplar->gaussian[0].width, 1.0f / exemplar->gaussian[0].height);
+			int width = std::stoi(argv[2]), height = std::stoi(argv[3]), frames = std::stoi(argv[4]);
+			SynthAnimator animator(exemplar, width, height, uvPerPixel, argc == 7 ? std::stoi(argv[6]) : 2, hashSeed);
+
+			// same speed as the GUI default, 0.25 lattice units per second
+			const float timeStep = 0.25f / 30.0f;
+			ThreadPool pool;
+			std::vector<unsigned char> rgba((size_t)width * height * 4);
+			for (int i = 0; i < frames; i++)
+			{
+				auto start = std::chrono::high_resolution_clock::now();
+				animator.frame(i * timeStep, rgba.data(), pool);
+				double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+				char name[32];
+				snprintf(name, sizeof(name), "_%04d.png", i);
+				PngStreamSink sink(argv[5] + std::string(name));
+				sink.begin(width, height);
+				for (int y = height - 1; y >= 0; y--)
+					sink.write(&rgba[(size_t)y * width * 4], 1);
+				sink.finish();
+				std::cout << "frame " << i << " in " << ms << " ms (" << (int)(animator.reuseRatio() * 100.0)
+						  << "% of the vertices reused)" << std::endl;
+			}
+			return EXIT_SUCCESS;
+		}
+
+		// NoiseSynth --bake-volume-gpu <size> <output.vol> [blendMode]
+		if ((argc == 4 || argc == 5) && std::string(argv[1]) == "--bake-volume-gpu")
+		{
+			NoiseSynth app("../data", true);
+			app.setHashSeed((int)hashSeed);
+			app.setBlendMode(argc == 5 ? std::stoi(argv[4]) : 2);
+			return app.bakeVolumeCompute(std::stoi(argv[2]), argv[3]) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		// NoiseSynth --bake-volume <size> <output.vol> [blendMode] [exemplar.nsx | source.vol gaussian.vol], no window
+		if (argc >= 4 && argc <= 7 && std::string(argv[1]) == "--bake-volume")
+		{
+			int size = std::stoi(argv[2]);
+			int blendMode = argc >= 5 ? std::stoi(argv[4]) : 2;
+			ThreadPool pool;
+			VolumeBrickWriter writer(argv[3], size, size, size);
+			VolumeBakeStats stats;
+			if (argc == 7)
+			{
+				// 3D exemplar, one exemplar voxel per output voxel
+				auto exemplar = LoadVolumeExemplar(argv[5], argv[6]);
+				stats = BakeVolume(writer, 1.0f / exemplar->width,
+					[&](glm::vec3 p) { return SynthesizeVoxel(*exemplar, p, blendMode, hashSeed); }, pool);
+			}
+			else
+			{
+				auto exemplar = argc == 6 ? LoadSynthExemplar(argv[5], options) : LoadSynthExemplar(noiseTexturePath, gaussianTexturePath, options);
+				float uvPerVoxel = 1.0f / exemplar->gaussian[0].width;
+				float lod = std::max(0.0f, ComputeLOD(*exemplar, glm::vec2(uvPerVoxel)));
+				stats = BakeVolume(writer, uvPerVoxel,
+					[&](glm::vec3 p) { return SynthesizeVoxel(*exemplar, p, lod, blendMode, hashSeed); }, pool);
+			}
+			std::cout << "CPU volume bake " << size << "^3 in " << stats.seconds << " s ("
+					  << stats.megaVoxelsPerSecond << " Mvox/s, " << pool.size() << " threads, "
+					  << stats.bytesInFlight / (1 << 20) << " MB of bricks)" << std::endl;
+			return EXIT_SUCCESS;
+		}
+
+#ifndef _WIN32
+		// NoiseSynth --daemon <socket> [<exemplar.nsx> | <noise.png> <gaussian.png>]...
+		if (argc >= 3 && std::string(argv[1]) == "--daemon")
+		{
+			std::vector<std::shared_ptr<const SynthExemplar>> exemplars;
+			for (int i = 3; i < argc; i++)
+			{
+				if (IsExemplarFile(argv[i]))
+					exemplars.push_back(LoadSynthExemplar(argv[i], options));
+				else if (i + 1 < argc)
+				{
+					exemplars.push_back(LoadSynthExemplar(argv[i], argv[i + 1], options));
+					i++;
+				}
+				else
+					throw std::runtime_error(std::string("missing gaussian for ") + argv[i]);
+			}
+			if (argc == 3)
+				for (const auto& path : libraryPaths)
+					exemplars.push_back(LoadSynthExemplar(path.source, path.gaussian, options));
+
+			TileServer server(argv[2], exemplars);
+			server.run();
+			return EXIT_SUCCESS;
+		}
+#endif
+
 		NoiseSynth app("../data");
 		app.run();
 	}
@@ -20,4 +237,4 @@ int main()
 	}
 
 	return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -1,114 +1,281 @@
 #include "objLoader.h"
+#include <charconv>
+#include <cstdlib>
+#include <future>
+#include <limits>
+#include <thread>
+#include "MappedFile.hpp"
+#include "../../base/thread_pool.h"
+
+namespace {
+
+// everything one slice of the file contributes, indices as written (negative ones fixed later)
+struct ObjChunk
+{
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> uvs;
+    std::vector<a_mesh> triangles;
+    // corners whose indices were negative: triangle * 3 + corner, and which attributes
+    std::vector<std::pair<size_t, int>> relative;
+    glm::vec3 min_vec = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max_vec = glm::vec3(-std::numeric_limits<float>::max());
+    bool failed = false;
+};
+
+inline const char* skip_blanks(const char* p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    return p;
+}
 
-bool obj_load(const char* filename, a_attrib* attrib , a_shape* shapes, glm::vec3* min_vec, glm::vec3* max_vec) {
-    std::ifstream file(filename);
-    std::string line;
-    std::string str;
-    attrib->_vertices.clear();
-    attrib->_normals.clear();
-    attrib->_uvs.clear();
-    //shapes->clear();
-    std::vector<glm::vec3> _vertices; //v
-    std::vector<float> _x; //x
-    std::vector<float> _y; //y
-    std::vector<float> _z; //z
-    std::vector<glm::vec3> _normals;  //vn
-    std::vector<glm::vec2> _uvs;	  //vt
-
-    while (getline(file, line))
-    {
-        if (line.substr(0, 2) == "vt")
-        {
-            glm::vec2 uv;
-            std::istringstream s(line.substr(3));
+inline const char* parse_float(const char* p, const char* end, float& value)
+{
+    p = skip_blanks(p, end);
+#if defined(__cpp_lib_to_chars)
+    // from_chars does not take a leading '+'
+    if (p < end && *p == '+')
+        p++;
+    auto result = std::from_chars(p, end, value);
+    return result.ec == std::errc() ? result.ptr : nullptr;
+#else
+    // no floating point from_chars (older libc++), strtof on a terminated copy
+    char buffer[64];
+    size_t length = 0;
+    while (p + length < end && length < sizeof(buffer) - 1 && p[length] != ' ' && p[length] != '\t' &&
+           p[length] != '\n' && p[length] != '\r')
+        length++;
+    memcpy(buffer, p, length);
+    buffer[length] = '\0';
+    char* last = nullptr;
+    value = strtof(buffer, &last);
+    return last == buffer ? nullptr : p + (last - buffer);
+#endif
+}
 
-            s >> uv.x >> uv.y;
+inline const char* parse_int(const char* p, const char* end, long long& value)
+{
+    auto result = std::from_chars(p, end, value);
+    return result.ec == std::errc() ? result.ptr : nullptr;
+}
 
-            _uvs.push_back(uv);
+// one face corner: v, v/vt, v//vn or v/vt/vn
+inline const char* parse_corner(const char* p, const char* end, long long index[3])
+{
+    index[0] = index[1] = index[2] = 0;
+    p = parse_int(p, end, index[0]);
+    if (!p || p == end || *p != '/')
+        return p;
+    p++;
+    if (p < end && *p != '/')
+    {
+        p = parse_int(p, end, index[1]);
+        if (!p || p == end || *p != '/')
+            return p;
+    }
+    return parse_int(p + 1, end, index[2]);
+}
 
+void parse_chunk(const char* p, const char* end, ObjChunk& chunk)
+{
+    std::vector<a_index> corners;
+    std::vector<int> negative;
+    while (p < end)
+    {
+        const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!line_end)
+            line_end = end;
+        p = skip_blanks(p, line_end);
+
+        if (line_end - p >= 2 && p[0] == 'v' && p[1] == 't')
+        {
+            glm::vec2 uv(0.0f);
+            const char* q = parse_float(p + 2, line_end, uv.x);
+            // v is optional, "vt u" leaves it at 0
+            const char* rest = q ? skip_blanks(q, line_end) : nullptr;
+            if (rest && rest < line_end && *rest != '\r')
+                q = parse_float(q, line_end, uv.y);
+            chunk.failed |= !q;
+            chunk.uvs.push_back(uv);
         }
-        else if (line.substr(0, 2) == "vn")
+        else if (line_end - p >= 2 && p[0] == 'v' && p[1] == 'n')
         {
-            glm::vec3 normal;
-            std::istringstream s(line.substr(3));
- 
-            s >> normal.x >> normal.y >> normal.z;
-
-         //   std::cout << normal.x << " " << normal.y<<" "<< normal.z << std::endl;
-            _normals.push_back(normal);
-
+            glm::vec3 normal(0.0f);
+            const char* q = p + 2;
+            for (int i = 0; i < 3 && q; i++)
+                q = parse_float(q, line_end, normal[i]);
+            chunk.failed |= !q;
+            chunk.normals.push_back(normal);
         }
-        else if (line.substr(0, 1) == "v")
+        else if (line_end - p >= 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
         {
-            glm::vec3 vertex;
-            std::istringstream s(line.substr(2));
-
-
-            s >> vertex.x >> vertex.y >> vertex.z;
-
-            _x.push_back(vertex.x);
-            _y.push_back(vertex.y);
-            _z.push_back(vertex.z);
-           _vertices.push_back(vertex);
-
-
+            glm::vec3 vertex(0.0f);
+            const char* q = p + 1;
+            for (int i = 0; i < 3 && q; i++)
+                q = parse_float(q, line_end, vertex[i]);
+            chunk.failed |= !q;
+            // bounds on the fly
+            chunk.min_vec = glm::min(chunk.min_vec, vertex);
+            chunk.max_vec = glm::max(chunk.max_vec, vertex);
+            chunk.vertices.push_back(vertex);
         }
-        else if (line.substr(0, 1) == "f")
+        else if (line_end - p >= 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
         {
             //f v1/vt1/vn1 v2/vt2/vn2 v3/vt3/vn3 ...
-            for (int k = 0; k < line.size(); k++) {
-                if (line[k] == '/')
-                    line[k] = ' ';
+            corners.clear();
+            negative.clear();
+            const char* q = skip_blanks(p + 1, line_end);
+            while (q && q < line_end && *q != '\r' && *q != '#')
+            {
+                long long index[3];
+                q = parse_corner(q, line_end, index);
+                if (!q)
+                    break;
+                // relative indices count back from the elements parsed so far in this chunk
+                int flags = 0;
+                long long counts[3] = {(long long)chunk.vertices.size(), (long long)chunk.uvs.size(), (long long)chunk.normals.size()};
+                for (int i = 0; i < 3; i++)
+                {
+                    if (index[i] < 0)
+                    {
+                        index[i] += counts[i] + 1;
+                        flags |= 1 << i;
+                    }
+                }
+                corners.push_back({(unsigned int)index[0], (unsigned int)index[2], (unsigned int)index[1]});
+                negative.push_back(flags);
+                q = skip_blanks(q, line_end);
+            }
+            if (!q || corners.size() < 3)
+            {
+                chunk.failed = true;
+                p = line_end + 1;
+                continue;
             }
 
-            std::istringstream vtns(line.substr(2));
-
-
-            a_mesh mesh;
+            // fan triangulation
+            for (size_t i = 1; i + 1 < corners.size(); i++)
+            {
+                size_t fan[3] = {0, i, i + 1};
+                a_mesh mesh;
+                for (int k = 0; k < 3; k++)
+                {
+                    mesh.mesh_vec[k] = corners[fan[k]];
+                    if (negative[fan[k]])
+                        chunk.relative.push_back({chunk.triangles.size() * 3 + k, negative[fan[k]]});
+                }
+                chunk.triangles.push_back(mesh);
+            }
+        }
+        p = line_end + 1;
+    }
+}
 
-            const std::string delim = "/";
+} // namespace
 
-            for (int i = 0; i < 3; i++) {
-                vtns >> mesh.mesh_vec[i].vertex_index;
-                vtns >> mesh.mesh_vec[i].uv_index;
-                vtns >> mesh.mesh_vec[i].normal_index;
-                //std::cout << mesh.mesh_vec[i].vertex_index << "/" << mesh.mesh_vec[i].uv_index << "/" << mesh.mesh_vec[i].normal_index << std::endl;
+bool obj_load(const char* filename, a_attrib* attrib , a_shape* shapes, glm::vec3* min_vec, glm::vec3* max_vec, int chunks) {
+    std::unique_ptr<MappedFile> file;
+    try
+    {
+        file.reset(new MappedFile(filename));
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << e.what() << std::endl;
+        return false;
+    }
+    const char* begin = reinterpret_cast<const char*>(file->data());
+    const char* end = begin + file->size();
 
-            }
-         
+    if (chunks <= 0)
+        chunks = (int)std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), file->size() / (4 << 20) + 1);
 
-            shapes->_indices.push_back(mesh);
+    // slices end on line boundaries
+    std::vector<const char*> bounds(1, begin);
+    for (int i = 1; i < chunks; i++)
+    {
+        const char* p = std::max(bounds.back(), begin + file->size() * i / chunks);
+        const char* line_end = p < end ? static_cast<const char*>(memchr(p, '\n', end - p)) : nullptr;
+        if (!line_end)
+            break;
+        bounds.push_back(line_end + 1);
+    }
+    bounds.push_back(end);
 
+    std::vector<ObjChunk> parsed(bounds.size() - 1);
+    if (parsed.size() == 1)
+        parse_chunk(bounds[0], bounds[1], parsed[0]);
+    else
+    {
+        ThreadPool pool((unsigned)parsed.size());
+        std::vector<std::future<void>> tasks;
+        for (size_t i = 0; i < parsed.size(); i++)
+            tasks.push_back(pool.submit([&, i] { parse_chunk(bounds[i], bounds[i + 1], parsed[i]); }));
+        for (auto& task : tasks)
+            task.get();
+    }
 
-        }
-        else if (line.substr(0, 1) == "#")
+    // concatenate, chunk local indices of relative corners become absolute
+    size_t vertices = 0, uvs = 0, normals = 0, triangles = 0;
+    for (const auto& chunk : parsed)
+    {
+        vertices += chunk.vertices.size();
+        uvs += chunk.uvs.size();
+        normals += chunk.normals.size();
+        triangles += chunk.triangles.size();
+    }
+    attrib->_vertices.clear();
+    attrib->_normals.clear();
+    attrib->_uvs.clear();
+    attrib->_vertices.reserve(vertices);
+    attrib->_uvs.reserve(uvs);
+    attrib->_normals.reserve(normals);
+    shapes->_indices.reserve(shapes->_indices.size() + triangles);
+
+    glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+    bool failed = false;
+    for (auto& chunk : parsed)
+    {
+        for (const auto& corner : chunk.relative)
         {
-
+            a_index& index = chunk.triangles[corner.first / 3].mesh_vec[corner.first % 3];
+            if (corner.second & 1)
+                index.vertex_index += (unsigned int)attrib->_vertices.size();
+            if (corner.second & 2)
+                index.uv_index += (unsigned int)attrib->_uvs.size();
+            if (corner.second & 4)
+                index.normal_index += (unsigned int)attrib->_normals.size();
         }
-        else
-        {
+        attrib->_vertices.insert(attrib->_vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+        attrib->_uvs.insert(attrib->_uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+        attrib->_normals.insert(attrib->_normals.end(), chunk.normals.begin(), chunk.normals.end());
+        shapes->_indices.insert(shapes->_indices.end(), chunk.triangles.begin(), chunk.triangles.end());
+        lo = glm::min(lo, chunk.min_vec);
+        hi = glm::max(hi, chunk.max_vec);
+        failed |= chunk.failed;
+    }
 
+    // every index has to land in its attribute array
+    for (const auto& mesh : shapes->_indices)
+    {
+        for (const auto& index : mesh.mesh_vec)
+        {
+            failed |= index.vertex_index == 0 || index.vertex_index > attrib->_vertices.size() ||
+                      index.uv_index > attrib->_uvs.size() || index.normal_index > attrib->_normals.size();
         }
     }
+    if (failed)
+    {
+        std::cout << "malformed obj " << filename << std::endl;
+        return false;
+    }
 
-    file.close();
-
-    attrib->_vertices.swap(_vertices);
-    attrib->_normals.swap(_normals);
-    attrib->_uvs.swap( _uvs);
-
-
-
-    max_vec->x = *std::max_element(_x.begin(), _x.end());
-    max_vec->y = *std::max_element(_y.begin(), _y.end());
-    max_vec->z = *std::max_element(_z.begin(), _z.end());
-
-   
-    min_vec->x = *std::min_element(_x.begin(), _x.end());
-    min_vec->y = *std::min_element(_y.begin(), _y.end());
-    min_vec->z = *std::min_element(_z.begin(), _z.end());
+    if (attrib->_vertices.empty())
+        lo = hi = glm::vec3(0.0f);
+    *min_vec = lo;
+    *max_vec = hi;
 
-  
     return true;
 }
 
@@ -139,7 +306,15 @@ bool obj_unload(const char* filename, a_attrib attrib, a_shape shapes) {
         for (const auto& mesh : shapes._indices) {
             file << "f ";
             for (const auto& index : mesh.mesh_vec) {
-                file << index.vertex_index << "/" << index.uv_index << "/" << index.normal_index << " ";
+                // missing attributes are left out, 0 is not a valid OBJ index
+                file << index.vertex_index;
+                if (index.uv_index != 0 || index.normal_index != 0)
+                    file << "/";
+                if (index.uv_index != 0)
+                    file << index.uv_index;
+                if (index.normal_index != 0)
+                    file << "/" << index.normal_index;
+                file << " ";
             }
             file << std::endl;
         }
@@ -150,4 +325,4 @@ bool obj_unload(const char* filename, a_attrib attrib, a_shape shapes) {
 
     return true;
 
-}
\ No newline at end of file
+}
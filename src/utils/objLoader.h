@@ -3,11 +3,11 @@
 
 #include <cstring>
 #include <fstream>
-#include <sstream>
 #include <vector>
 #include <algorithm>
 #include "../base/application.h"
 
+// 1-based as in the file, 0 when the face does not reference the attribute
 typedef struct
 {
 	unsigned int vertex_index; //v
@@ -35,6 +35,12 @@ typedef struct
 
 const std::string export_path = "../export/";
 
-bool obj_load(const char *filename, a_attrib *attrib, a_shape *shapes, glm::vec3 *min_vec, glm::vec3 *max_vec);
+/*
+ * @brief parse v, vt, vn and f from a memory-mapped OBJ file, faces of any size
+ *        in v, v/vt, v//vn or v/vt/vn form with negative (relative) indices,
+ *        polygons are fan triangulated; chunks > 1 parses that many slices of
+ *        the file in parallel, 0 picks one slice per 4 MB up to the core count
+ */
+bool obj_load(const char *filename, a_attrib *attrib, a_shape *shapes, glm::vec3 *min_vec, glm::vec3 *max_vec, int chunks = 0);
 
 bool obj_unload(const char *filename, a_attrib attrib, a_shape shapes);
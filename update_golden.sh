@@ -0,0 +1,24 @@
+#!/bin/sh
+# Writes the references of `NoiseSynth --golden` from a known-good revision, to be committed afterwards:
+#   ./update_golden.sh <revision> [directory, data/golden by default]
+# The revision is built in a temporary worktree and rendered with Mesa llvmpipe. Its shaders and data
+# are used, the gaussianized exemplars come from gaussian_output/ of this checkout (see gaussianize.py).
+set -e
+
+revision=${1:?usage: update_golden.sh <revision> [directory]}
+root=$(cd "$(dirname "$0")" && pwd)
+directory=${2:-$root/data/golden}
+case "$directory" in /*) ;; *) directory="$PWD/$directory" ;; esac
+
+worktree=$(mktemp -d)
+trap 'git -C "$root" worktree remove --force "$worktree" || rm -rf "$worktree"' EXIT
+git -C "$root" worktree add --detach "$worktree" "$revision"
+ln -s "$root/gaussian_output" "$worktree/gaussian_output"
+
+cmake -S "$worktree" -B "$worktree/_golden_build" -DCMAKE_BUILD_TYPE=Release
+cmake --build "$worktree/_golden_build" -j"$(getconf _NPROCESSORS_ONLN)"
+
+# the default ../data and ../shader paths resolve from src/
+cd "$worktree/src"
+LIBGL_ALWAYS_SOFTWARE=1 "$worktree/_golden_build/NoiseSynth" --golden "$directory" --update
+echo "References of $(git -C "$root" rev-parse --short "$revision") written to $directory"